@@ -1,6 +1,9 @@
 
 #include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <thread>
 
 #include "opendrive_parser.hpp"
 #include "tsim_object.hpp"
@@ -8,20 +11,100 @@
 
 int main(int argc, char* argv[]) {
     std::string filename{"../xodr/Town01.xodr"};
-    // std::string filename{"../xodr/TownBig.xodr"};
+    // larger maps: ./tsim_map_generator --roads 100000 ../xodr/TownBig.xodr
 
     std::vector<std::string> args(argv + 1, argv + argc);
-    if (argc > 1) filename = args.front();
+    std::vector<std::string> filenames;
+    parser::ParserOptions options;
+    options.frenetTable = true;  // vehicles move along their lane center at a constant speed
+    tsim::StreamingOptions streaming;
+    bool stream{false};
+    bool watch{false};
+    for (const auto& arg : args) {
+        if (arg == "--cache") {
+            options.mapCache = true;  // compiled map next to the OpenDrive file
+        } else if (arg.rfind("--tolerance=", 0) == 0) {
+            options.tolerance = std::stod(arg.substr(std::string("--tolerance=").size()));
+        } else if (arg == "--lazy") {
+            options.lazyGeometry = true;  // lane geometry is calculated when vehicles reach it
+        } else if (arg == "--parallel-read") {
+            options.parallelRead = true;  // for very large files
+        } else if (arg.rfind("--stream-radius=", 0) == 0) {
+            // lane geometry only around the vehicles, coarse elsewhere
+            streaming.radius = std::stod(arg.substr(std::string("--stream-radius=").size()));
+            options.lazyGeometry = true;
+            stream = true;
+        } else if (arg == "--watch") {
+            watch = true;  // edits of the file are reloaded into the running simulation
+        } else if (arg.rfind("--max-points=", 0) == 0) {
+            options.maxResidentPoints = std::stoul(arg.substr(std::string("--max-points=").size()));
+        } else {
+            filenames.push_back(arg);
+        }
+    }
+    if (filenames.size() == 1) filename = filenames.front();
 
-    std::cout << "loading OpenDrive file " << filename << std::endl;
-
-    parser::OpenDriveParser parser;
-    auto map = parser.parse(filename);
+    parser::OpenDriveParser parser(options);
+    std::shared_ptr<tsim::Map> map;
+    if (filenames.size() > 1) {
+        // several files are tiles of one map in the same frame, each with its own id range
+        std::vector<parser::MapTile> tiles;
+        for (std::size_t i = 0; i < filenames.size(); i++) {
+            parser::MapTile tile;
+            tile.filename = filenames[i];
+            tile.idOffset = static_cast<uint32_t>(i * 1000000);
+            tiles.push_back(tile);
+        }
+        std::cout << "loading " << tiles.size() << " OpenDrive tiles" << std::endl;
+        map = parser.parse(tiles);
+    } else {
+        std::cout << "loading OpenDrive file " << filename << std::endl;
+        map = parser.parse(filename);
+    }
+    const auto& stats = parser.statistics();
+    std::cout << "loaded " << stats.roads << " roads, " << stats.junctions << " junctions, "
+              << stats.lanes << " lanes, " << stats.points << " points";
+    if (stats.tolerance > 0) std::cout << " (tolerance " << stats.tolerance << " m)";
+    std::cout << " in " << stats.totalMs << " ms";
+    if (stats.fromCache) {
+        std::cout << " from map cache" << std::endl;
+    } else {
+        std::cout << " (read " << stats.readMs << " ms, tessellate " << stats.tessellateMs
+                  << " ms on " << stats.threads << " threads, merge " << stats.mergeMs
+                  << " ms, read stalled " << stats.stallMs << " ms, link " << stats.linkMs
+                  << " ms, " << stats.clippedPoints << " boundary points saved by section clipping)"
+                  << std::endl;
+        if (stats.tiles > 0) {
+            std::cout << stats.seams << " roads linked across tile seams" << std::endl;
+        }
+    }
 
     tsim::Simulator sim(map);
     std::size_t num_vehicles = 10;
 
     for (std::size_t i = 0; i < num_vehicles; i++) sim.addVehicle();
+    if (stream) sim.streamMap(streaming);
+    if (watch && filenames.size() <= 1) {
+        sim.addThread(std::thread([&parser, &sim, map, filename]() {
+            auto modified = std::filesystem::last_write_time(filename);
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                auto time = std::filesystem::last_write_time(filename);
+                if (time == modified) continue;
+                modified = time;
+                try {
+                    parser.reload(filename, map, &sim.stepMutex());
+                    const auto& reload = parser.statistics();
+                    std::cout << "reloaded " << reload.changedRoads << " changed roads, relinked "
+                              << reload.relinkedRoads << ", removed " << reload.removedRoads
+                              << " in " << reload.totalMs << " ms (map locked " << reload.swapMs
+                              << " ms)" << std::endl;
+                } catch (const std::exception& e) {
+                    std::cerr << "reload failed: " << e.what() << std::endl;
+                }
+            }
+        }));
+    }
 
     sim.run();
 }
\ No newline at end of file
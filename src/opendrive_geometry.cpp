@@ -0,0 +1,521 @@
+#include "opendrive_geometry.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "tsim_util.hpp"
+
+namespace parser {
+
+namespace {
+// geometries overlapping the s range by less than this are skipped, section starts are rounded in
+// the file
+constexpr double S_EPSILON{1e-6};
+// number of points at which the curvature of a paramPoly3 is checked for error bounded sampling
+constexpr std::size_t CURVATURE_SAMPLES{32};
+// offset pieces that continue the previous piece closer than this need no sample at their start
+constexpr double BREAK_EPSILON{1e-9};
+
+// largest absolute value of a piecewise polynomial between s_start and s_end
+double maxValue(const std::vector<tsim::CubicPolynomial>& pieces, double s_start, double s_end) {
+  double result{0};
+  for (std::size_t i = 0; i < pieces.size(); i++) {
+    double from = i == 0 ? s_start : std::max(s_start, pieces[i].sOffset);
+    double to = i + 1 < pieces.size() ? std::min(s_end, pieces[i + 1].sOffset) : s_end;
+    if (from > to) continue;
+    // at one end of the range or where the derivative b + 2c ds + 3d ds^2 is 0
+    const auto& piece = pieces[i];
+    result = std::max({result, std::abs(piece.evaluate(from)), std::abs(piece.evaluate(to))});
+    double roots[2];
+    std::size_t count{0};
+    if (piece.d != 0) {
+      double discriminant = piece.c * piece.c - 3 * piece.d * piece.b;
+      if (discriminant >= 0) {
+        roots[count++] = (-piece.c + std::sqrt(discriminant)) / (3 * piece.d);
+        roots[count++] = (-piece.c - std::sqrt(discriminant)) / (3 * piece.d);
+      }
+    } else if (piece.c != 0) {
+      roots[count++] = -piece.b / (2 * piece.c);
+    }
+    for (std::size_t r = 0; r < count; r++) {
+      double s = piece.sOffset + roots[r];
+      if (s > from && s < to) result = std::max(result, std::abs(piece.evaluate(s)));
+    }
+  }
+  return result;
+}
+
+// largest absolute second derivative of a piecewise polynomial between s_start and s_end
+double maxSecondDerivative(const std::vector<tsim::CubicPolynomial>& pieces, double s_start,
+                           double s_end) {
+  double result{0};
+  for (std::size_t i = 0; i < pieces.size(); i++) {
+    double from = i == 0 ? s_start : std::max(s_start, pieces[i].sOffset);
+    double to = i + 1 < pieces.size() ? std::min(s_end, pieces[i + 1].sOffset) : s_end;
+    if (from > to) continue;
+    // linear in ds, largest at one end of the range
+    const auto& piece = pieces[i];
+    for (double ds : {from - piece.sOffset, to - piece.sOffset}) {
+      result = std::max(result, std::abs(2 * piece.c + 6 * piece.d * ds));
+    }
+  }
+  return result;
+}
+
+// largest absolute first derivative of a piecewise polynomial between s_start and s_end
+double maxFirstDerivative(const std::vector<tsim::CubicPolynomial>& pieces, double s_start,
+                          double s_end) {
+  double result{0};
+  for (std::size_t i = 0; i < pieces.size(); i++) {
+    double from = i == 0 ? s_start : std::max(s_start, pieces[i].sOffset);
+    double to = i + 1 < pieces.size() ? std::min(s_end, pieces[i + 1].sOffset) : s_end;
+    if (from > to) continue;
+    // at one end of the range or at the vertex of the parabola
+    const auto& piece = pieces[i];
+    result = std::max(
+      {result, std::abs(piece.derivative(from)), std::abs(piece.derivative(to))});
+    if (piece.d != 0) {
+      double s = piece.sOffset - piece.c / (3 * piece.d);
+      if (s > from && s < to) result = std::max(result, std::abs(piece.derivative(s)));
+    }
+  }
+  return result;
+}
+
+// starts of pieces between s_start and s_end that do not continue the previous piece smoothly
+void addBreaks(const std::vector<tsim::CubicPolynomial>& pieces, double s_start, double s_end,
+               std::vector<double>* breaks) {
+  for (std::size_t i = 1; i < pieces.size(); i++) {
+    const auto& previous = pieces[i - 1];
+    const auto& piece = pieces[i];
+    if (piece.sOffset <= s_start || piece.sOffset >= s_end) continue;
+    double value = previous.evaluate(piece.sOffset);
+    double slope = previous.derivative(piece.sOffset);
+    if (std::abs(value - piece.a) > BREAK_EPSILON || std::abs(slope - piece.b) > BREAK_EPSILON) {
+      breaks->push_back(piece.sOffset);
+    }
+  }
+}
+
+// points of the reference line moved by offsets[i] along the normals. The coordinates go to float
+// rows first, a loop the compiler vectorizes (float stores cannot alias the double rows read), and
+// are packed into points in a second pass: the interleaved stores of the point members keep a
+// single loop from vectorizing.
+std::vector<tsim::Point> offsetPoints(const ReferenceLine& reference_line, const double* offsets) {
+  const std::size_t size = reference_line.size();
+  const double* x = reference_line.x.data();
+  const double* y = reference_line.y.data();
+  const double* z = reference_line.z.data();
+  const double* nx = reference_line.nx.data();
+  const double* ny = reference_line.ny.data();
+  const double* nz = reference_line.nz.data();
+  std::vector<float> rows(3 * size);
+  float* px = rows.data();
+  float* py = px + size;
+  float* pz = py + size;
+  for (std::size_t i = 0; i < size; i++) {
+    px[i] = static_cast<float>(x[i] + offsets[i] * nx[i]);
+    py[i] = static_cast<float>(y[i] + offsets[i] * ny[i]);
+    pz[i] = static_cast<float>(z[i] + offsets[i] * nz[i]);
+  }
+  std::vector<tsim::Point> points(size);
+  for (std::size_t i = 0; i < size; i++) points[i] = tsim::Point(px[i], py[i], pz[i]);
+  return points;
+}
+}  // namespace
+
+tsim::RoadSegment toRoadSegment(const GeometryRecord& geom) {
+  tsim::RoadSegment segment;
+  if (geom.type == GeometryType::eARC) {
+    segment.type = tsim::SegmentType::eARC;
+  } else if (geom.type == GeometryType::eSPIRAL) {
+    segment.type = tsim::SegmentType::eSPIRAL;
+  } else if (geom.type == GeometryType::ePARAM_POLY3) {
+    segment.type = tsim::SegmentType::ePARAM_POLY3;
+  }
+  segment.s = geom.s;
+  segment.x = geom.x;
+  segment.y = geom.y;
+  segment.hdg = geom.hdg;
+  segment.length = geom.length;
+  segment.curvature = geom.curvature;
+  segment.curvatureEnd = geom.curvatureEnd;
+  segment.u = geom.u;
+  segment.v = geom.v;
+  segment.pRange = geom.pRange;
+  return segment;
+}
+
+GeometryRecord clipGeometry(const GeometryRecord& geom, double from, double to) {
+  GeometryRecord part = geom;
+  if (geom.type == GeometryType::eSPIRAL) {
+    double rate = (geom.curvatureEnd - geom.curvature) / geom.length;
+    part.curvature = geom.curvature + rate * from;
+    part.curvatureEnd = geom.curvature + rate * to;
+  } else if (geom.type == GeometryType::ePARAM_POLY3) {
+    // substitute p = p0 + q, the polynomials stay in the local frame of the geometry
+    double p0 = from * geom.pRange / geom.length;
+    for (auto* coefficients : {&part.u, &part.v}) {
+      auto c = *coefficients;
+      *coefficients = {((c[3] * p0 + c[2]) * p0 + c[1]) * p0 + c[0],
+                       (3 * c[3] * p0 + 2 * c[2]) * p0 + c[1], 3 * c[3] * p0 + c[2], c[3]};
+    }
+    part.pRange = (to - from) * geom.pRange / geom.length;
+    part.s += from;
+    part.length = to - from;
+    return part;
+  }
+  if (from > 0) {
+    if (geom.type == GeometryType::eSPIRAL) {
+      toRoadSegment(geom).evaluate(&from, 1, &part.x, &part.y, &part.hdg);
+    } else if (geom.type == GeometryType::eARC) {
+      part.x += (std::sin(geom.hdg + from * geom.curvature) - std::sin(geom.hdg)) / geom.curvature;
+      part.y -= (std::cos(geom.hdg + from * geom.curvature) - std::cos(geom.hdg)) / geom.curvature;
+      part.hdg += from * geom.curvature;
+    } else {
+      part.x += from * std::cos(geom.hdg);
+      part.y += from * std::sin(geom.hdg);
+    }
+    part.s += from;
+  }
+  part.length = to - from;
+  return part;
+}
+
+double planViewEnd(const std::vector<GeometryRecord>& plan_view) {
+  return plan_view.empty() ? 0 : plan_view.back().s + plan_view.back().length;
+}
+
+ReferenceLine sampleReferenceLine(const std::vector<GeometryRecord>& plan_view, double s_start,
+                                  double s_end, double max_offset, double tolerance,
+                                  double max_step, const std::vector<double>& breaks) {
+  // the range is split at the breaks, every part starts and ends with a sample
+  std::vector<double> bounds{s_start};
+  for (auto s : breaks) {
+    if (s > bounds.back() + S_EPSILON && s < s_end - S_EPSILON) bounds.push_back(s);
+  }
+  bounds.push_back(s_end);
+
+  ReferenceLine referenceLine;
+  // fixed sampling: a point per meter on straights and curves, 21 per arc. Error bounded sampling
+  // needs fewer.
+  std::size_t capacity = 2 * bounds.size();
+  for (const auto& geom : plan_view) {
+    if (geom.s + geom.length <= s_start + S_EPSILON) continue;
+    if (geom.s >= s_end - S_EPSILON) break;
+    double length = std::min(geom.s + geom.length, s_end) - std::max(geom.s, s_start);
+    capacity += geom.type == GeometryType::eARC ? 22 : static_cast<std::size_t>(length) + 3;
+  }
+  referenceLine.reserve(capacity);
+  for (std::size_t i = 0; i + 1 < bounds.size(); i++) {
+    double from = bounds[i];
+    double to = bounds[i + 1];
+    for (const auto& geom : plan_view) {
+      if (geom.s + geom.length <= from + S_EPSILON) continue;
+      if (geom.s >= to - S_EPSILON) break;
+      // line, spiral, arc, poly3, parampoly3
+      auto part =
+        clipGeometry(geom, std::max(0.0, from - geom.s), std::min(geom.length, to - geom.s));
+      if (part.type == GeometryType::eARC) {
+        sampleArc(part, max_offset, tolerance, max_step, &referenceLine);
+      } else if (part.type == GeometryType::eSPIRAL || part.type == GeometryType::ePARAM_POLY3) {
+        sampleCurve(part, max_offset, tolerance, max_step, &referenceLine);
+      } else {
+        sampleStraight(part, tolerance, max_step, &referenceLine);
+      }
+    }
+  }
+  return referenceLine;
+}
+
+void sampleStraight(const GeometryRecord& geom, double tolerance, double max_step,
+                    ReferenceLine* line) {
+  double x = geom.x;
+  double y = geom.y;
+  double cosHdg = std::cos(geom.hdg);
+  double sinHdg = std::sin(geom.hdg);
+
+  line->add(geom.s, x, y, -sinHdg, cosHdg);
+  double xEnd = x + geom.length * cosHdg;
+  double yEnd = y + geom.length * sinHdg;
+
+  if (tolerance > 0) {
+    // error bounded tessellation: a straight is exact with its end points, curved lane offsets may
+    // need more
+    std::size_t segments{1};
+    if (max_step > 0) segments = std::max<std::size_t>(1, std::ceil(geom.length / max_step));
+    for (std::size_t i = 1; i < segments; i++) {
+      double ds = geom.length * i / segments;
+      line->add(geom.s + ds, x + ds * cosHdg, y + ds * sinHdg, -sinHdg, cosHdg);
+    }
+    line->add(geom.s + geom.length, xEnd, yEnd, -sinHdg, cosHdg);
+    return;
+  }
+
+  double roadLength{0};
+  double step = 1.f;
+  while (roadLength < geom.length) {
+    x += step * cosHdg;
+    y += step * sinHdg;
+    roadLength += step;
+    line->add(geom.s + roadLength, x, y, -sinHdg, cosHdg);
+  }
+  line->add(geom.s + geom.length, xEnd, yEnd, -sinHdg, cosHdg);
+}
+
+void sampleArc(const GeometryRecord& geom, double max_offset, double tolerance, double max_step,
+               ReferenceLine* line) {
+  // points on the arc are center + radius * (cos(angle), sin(angle)), the left normal is
+  // -sgn(arc) * (cos(angle), sin(angle))
+  double arc = geom.curvature;
+  double sign = tsim::util::sgn(arc);
+  line->add(geom.s, geom.x, geom.y, -std::sin(geom.hdg), std::cos(geom.hdg));
+
+  auto xM = geom.x + 1 / arc * -std::sin(geom.hdg);
+  auto yM = geom.y + 1 / arc * std::cos(geom.hdg);
+  double radius = 1 / std::abs(arc);
+  double start_angle = geom.hdg - sign * M_PI / 2;
+  double end_angle = start_angle + geom.length * arc;
+  auto addAngle = [&](double angle) {
+    double cosAngle = std::cos(angle);
+    double sinAngle = std::sin(angle);
+    line->add(geom.s + (angle - start_angle) / arc, xM + radius * cosAngle, yM + radius * sinAngle,
+              -sign * cosAngle, -sign * sinAngle);
+  };
+
+  if (tolerance > 0) {
+    // error bounded tessellation: the chord error (sagitta) r * (1 - cos(step / 2)) of every segment
+    // stays below the tolerance. The outermost lane has the largest radius and needs the most
+    // points, all lanes share its sampling.
+    double outerRadius = radius + std::abs(max_offset);
+    std::size_t segments{1};
+    if (tolerance < outerRadius) {
+      double maxStep = 2 * std::acos(1 - tolerance / outerRadius);
+      segments = std::max<std::size_t>(1, std::ceil(std::abs(end_angle - start_angle) / maxStep));
+    }
+    if (max_step > 0) {
+      segments = std::max<std::size_t>(segments, std::ceil(geom.length / max_step));
+    }
+    line->reserve(line->size() + segments);
+    for (std::size_t i = 1; i < segments; i++) {
+      addAngle(start_angle + (end_angle - start_angle) * i / segments);
+    }
+    addAngle(end_angle);
+    return;
+  }
+
+  for (double angle = start_angle; sign * angle < sign * end_angle;
+       angle += geom.length * arc / 20) {
+    addAngle(angle);
+  }
+  addAngle(end_angle);
+}
+
+void sampleCurve(const GeometryRecord& geom, double max_offset, double tolerance, double max_step,
+                 ReferenceLine* line) {
+  auto segment = toRoadSegment(geom);
+  // points every meter as for straights, at least as many as for an arc
+  auto segments = std::max<std::size_t>(20, std::ceil(geom.length));
+  if (tolerance > 0) {
+    // error bounded tessellation: steps are chosen as for an arc with the largest curvature of the
+    // geometry. Spirals have it at one of their ends, for paramPoly3 it is estimated.
+    double maxCurvature = std::max(std::abs(geom.curvature), std::abs(geom.curvatureEnd));
+    if (geom.type == GeometryType::ePARAM_POLY3) {
+      maxCurvature = 0;
+      for (std::size_t i = 0; i <= CURVATURE_SAMPLES; i++) {
+        auto pose = segment.evaluate(geom.length * i / CURVATURE_SAMPLES);
+        maxCurvature = std::max(maxCurvature, std::abs(pose.curvature));
+      }
+    }
+    segments = 1;
+    double outerRadius = 1 / maxCurvature + std::abs(max_offset);
+    if (maxCurvature > 0 && tolerance < outerRadius) {
+      double maxStep = 2 * std::acos(1 - tolerance / outerRadius);
+      segments = std::max<std::size_t>(1, std::ceil(geom.length * maxCurvature / maxStep));
+    }
+    if (max_step > 0) {
+      segments = std::max<std::size_t>(segments, std::ceil(geom.length / max_step));
+    }
+  }
+
+  std::vector<double> ds(segments + 1);
+  for (std::size_t i = 0; i <= segments; i++) ds[i] = geom.length * i / segments;
+  std::size_t first = line->size();
+  line->resize(first + ds.size());
+  // headings are written to nx and turned into the left normal in place
+  segment.evaluate(ds.data(), ds.size(), &line->x[first], &line->y[first], &line->nx[first]);
+  for (std::size_t i = first; i < line->size(); i++) {
+    line->s[i] = geom.s + ds[i - first];
+    double heading = line->nx[i];
+    line->nx[i] = -std::sin(heading);
+    line->ny[i] = std::cos(heading);
+  }
+}
+
+void applyRoadProfiles(const std::vector<tsim::CubicPolynomial>& elevations,
+                       const std::vector<tsim::CubicPolynomial>& superelevations,
+                       ReferenceLine* line) {
+  // flat roads keep the z and nz of 0 the samples were added with
+  if (!elevations.empty()) {
+    tsim::evaluatePiecewise(elevations, line->s.data(), line->size(), line->z.data());
+  }
+  if (superelevations.empty()) return;
+  // the bank angle is written to nz and turned into the vertical part of the lateral vector in
+  // place
+  double* nx = line->nx.data();
+  double* ny = line->ny.data();
+  double* nz = line->nz.data();
+  tsim::evaluatePiecewise(superelevations, line->s.data(), line->size(), nz);
+  for (std::size_t i = 0; i < line->size(); i++) {
+    double cosBank = std::cos(nz[i]);
+    nx[i] *= cosBank;
+    ny[i] *= cosBank;
+    nz[i] = std::sin(nz[i]);
+  }
+}
+
+std::vector<tsim::Point> calculateOffsetPoints(const ReferenceLine& reference_line, double offset) {
+  std::vector<double> offsets(reference_line.size(), offset);
+  return offsetPoints(reference_line, offsets.data());
+}
+
+std::vector<tsim::Point> calculateOffsetPoints(const ReferenceLine& reference_line,
+                                               const double* offsets) {
+  return offsetPoints(reference_line, offsets);
+}
+
+void BoundaryLayout::evaluateOffsets(const double* s, std::size_t n, double* out) const {
+  if (boundaryCount() == 0) return;
+  tsim::evaluatePiecewise(laneOffsets, s, n, out);
+  for (std::size_t j = 1; j < boundaryCount(); j++) {
+    double* row = out + j * n;
+    const double* innerRow = out + inner[j] * n;
+    double side = sides[j];
+    tsim::evaluatePiecewise(widths[j], s, n, row);
+    for (std::size_t i = 0; i < n; i++) row[i] = innerRow[i] + side * row[i];
+  }
+}
+
+double BoundaryLayout::maxOffset() const {
+  if (boundaryCount() == 0) return 0;
+  // the offset of a boundary is at most the sum of the largest lane offset and widths on the way
+  std::vector<double> bounds(boundaryCount());
+  bounds[0] = maxValue(laneOffsets, sStart, sEnd);
+  double maxOffset = bounds[0];
+  for (std::size_t j = 1; j < boundaryCount(); j++) {
+    bounds[j] = bounds[inner[j]] + maxValue(widths[j], sStart, sEnd);
+    maxOffset = std::max(maxOffset, bounds[j]);
+  }
+  return maxOffset;
+}
+
+double BoundaryLayout::maxStep(double tolerance) const {
+  if (tolerance <= 0 || boundaryCount() == 0) return 0;
+  // bound of the second derivative of every boundary offset, the chord error of a step h is at most
+  // bound * h^2 / 8
+  std::vector<double> bounds(boundaryCount());
+  bounds[0] = maxSecondDerivative(laneOffsets, sStart, sEnd);
+  double maxBound = bounds[0];
+  for (std::size_t j = 1; j < boundaryCount(); j++) {
+    bounds[j] = bounds[inner[j]] + maxSecondDerivative(widths[j], sStart, sEnd);
+    maxBound = std::max(maxBound, bounds[j]);
+  }
+  // the profiles move the boundaries by elevation(s) + offset * sin(superelevation(s)), which
+  // curves them vertically even on straights. The coupling of changing widths and superelevation is
+  // neglected.
+  if (!elevations.empty() || !superelevations.empty()) {
+    double bankRate = maxFirstDerivative(superelevations, sStart, sEnd);
+    maxBound += maxSecondDerivative(elevations, sStart, sEnd) +
+                maxOffset() * (maxSecondDerivative(superelevations, sStart, sEnd) +
+                               bankRate * bankRate);
+  }
+  return maxBound > 0 ? std::sqrt(8 * tolerance / maxBound) : 0;
+}
+
+std::vector<double> BoundaryLayout::breaks() const {
+  std::vector<double> result;
+  addBreaks(laneOffsets, sStart, sEnd, &result);
+  for (const auto& width : widths) addBreaks(width, sStart, sEnd, &result);
+  addBreaks(elevations, sStart, sEnd, &result);
+  addBreaks(superelevations, sStart, sEnd, &result);
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+BoundaryLayout layoutLaneBoundaries(const RoadRecord& road, std::size_t section_index) {
+  const auto& section = road.sections[section_index];
+  BoundaryLayout layout;
+  layout.sStart = section.s;
+  layout.sEnd = section_index + 1 < road.sections.size() ? road.sections[section_index + 1].s
+                                                         : planViewEnd(road.planView);
+  layout.laneOffsets = road.laneOffsets;
+  layout.elevations = road.elevations;
+  layout.superelevations = road.superelevations;
+  layout.widths.emplace_back();
+  layout.sides.push_back(0);
+  layout.inner.push_back(0);
+  layout.laneBoundaries.resize(section.lanes.size());
+  // the outer boundary of a lane is the inner boundary of the next one on the same side
+  for (int side : {1, -1}) {
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < section.lanes.size(); i++) {
+      if (tsim::util::sgn(section.lanes[i].id) == side) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&section](std::size_t a, std::size_t b) {
+      return std::abs(section.lanes[a].id) < std::abs(section.lanes[b].id);
+    });
+    uint32_t inner{0};
+    for (auto i : order) {
+      // widths are relative to the section start
+      auto widths = section.lanes[i].widths;
+      for (auto& width : widths) width.sOffset += section.s;
+      layout.widths.push_back(std::move(widths));
+      layout.sides.push_back(side);
+      layout.inner.push_back(inner);
+      auto outer = static_cast<uint32_t>(layout.widths.size() - 1);
+      layout.laneBoundaries[i] = LaneBoundaries{inner, outer};
+      inner = outer;
+    }
+  }
+  return layout;
+}
+
+ReferenceLine sampleLaneSection(const std::vector<GeometryRecord>& plan_view,
+                                const BoundaryLayout& layout, double tolerance) {
+  auto referenceLine =
+    sampleReferenceLine(plan_view, layout.sStart, layout.sEnd, layout.maxOffset(), tolerance,
+                        layout.maxStep(tolerance), layout.breaks());
+  applyRoadProfiles(layout.elevations, layout.superelevations, &referenceLine);
+  return referenceLine;
+}
+
+LaneSectionGeometry::LaneSectionGeometry(const std::vector<GeometryRecord>& plan_view,
+                                         BoundaryLayout layout, double tolerance)
+    : m_layout(std::move(layout))
+    , m_tolerance(tolerance) {
+  for (const auto& geom : plan_view) {
+    if (geom.s + geom.length <= m_layout.sStart + S_EPSILON) continue;
+    if (geom.s >= m_layout.sEnd - S_EPSILON) break;
+    m_planView.push_back(geom);
+  }
+}
+
+std::vector<std::vector<tsim::Point>> LaneSectionGeometry::boundaries() const {
+  auto referenceLine = sampleLaneSection(m_planView, m_layout, m_tolerance);
+  std::size_t samples = referenceLine.size();
+  std::vector<double> offsets(m_layout.boundaryCount() * samples);
+  m_layout.evaluateOffsets(referenceLine.s.data(), samples, offsets.data());
+  std::vector<std::vector<tsim::Point>> boundaries;
+  boundaries.reserve(m_layout.boundaryCount());
+  for (std::size_t j = 0; j < m_layout.boundaryCount(); j++) {
+    boundaries.push_back(calculateOffsetPoints(referenceLine, offsets.data() + j * samples));
+  }
+  return boundaries;
+}
+
+}  // namespace parser
@@ -0,0 +1,111 @@
+#ifndef __OPENDRIVE_GEOMETRY_HPP__
+#define __OPENDRIVE_GEOMETRY_HPP__
+
+#include <cstddef>
+#include <vector>
+
+#include "opendrive_records.hpp"
+#include "tsim_geometry_cache.hpp"
+
+namespace parser {
+
+// Tessellation of the OpenDRIVE planView. Depends on the records only, so geometry can be
+// calculated after parsing has finished (see LaneSectionGeometry). tolerance is the maximum chord
+// error, 0 for fixed sampling (see ParserOptions::tolerance).
+
+// part of geom between from and to (local s). Points on the part are the same as on geom, only the
+// sampling restarts at from.
+GeometryRecord clipGeometry(const GeometryRecord& geom, double from, double to);
+
+// the geometry as segment of a tsim::Road, also used to evaluate spirals and paramPoly3
+tsim::RoadSegment toRoadSegment(const GeometryRecord& geom);
+
+// s at the end of the last geometry
+double planViewEnd(const std::vector<GeometryRecord>& plan_view);
+
+// samples the reference line from s_start to s_end. max_offset is the largest lateral offset that
+// will be applied to the samples. With a tolerance samples are at most max_step apart (0: no
+// limit). Every s in breaks is sampled, lateral offsets may have a kink there.
+ReferenceLine sampleReferenceLine(const std::vector<GeometryRecord>& plan_view, double s_start,
+                                  double s_end, double max_offset, double tolerance,
+                                  double max_step = 0, const std::vector<double>& breaks = {});
+void sampleStraight(const GeometryRecord& geom, double tolerance, double max_step,
+                    ReferenceLine* line);
+void sampleArc(const GeometryRecord& geom, double max_offset, double tolerance, double max_step,
+               ReferenceLine* line);
+// spiral and paramPoly3, all samples of a geometry are evaluated in one batch
+void sampleCurve(const GeometryRecord& geom, double max_offset, double tolerance, double max_step,
+                 ReferenceLine* line);
+
+// z of the samples from the elevation, the normals are rolled around the reference line by the
+// superelevation and become the lateral unit vectors (nx, ny, nz) of the road surface. Both
+// profiles are evaluated for all samples in one batch.
+void applyRoadProfiles(const std::vector<tsim::CubicPolynomial>& elevations,
+                       const std::vector<tsim::CubicPolynomial>& superelevations,
+                       ReferenceLine* line);
+
+// reference line samples moved along the normal
+std::vector<tsim::Point> calculateOffsetPoints(const ReferenceLine& reference_line, double offset);
+// with one offset per sample
+std::vector<tsim::Point> calculateOffsetPoints(const ReferenceLine& reference_line,
+                                               const double* offsets);
+
+// Lane boundaries of a section. Index 0 is the center lane (the reference line moved by the lane
+// offset of the road), lanes are stacked outwards in the order of their absolute id.
+struct BoundaryLayout {
+  double sStart{0};
+  double sEnd{0};
+  std::vector<LaneBoundaries> laneBoundaries;  // same order as the lanes in the record
+  // per boundary: width of the lane it is the outer boundary of (sOffset along the road), side of
+  // the lane (1 left, -1 right) and its inner boundary. Empty for the center lane.
+  std::vector<std::vector<tsim::CubicPolynomial>> widths;
+  std::vector<int> sides;
+  std::vector<uint32_t> inner;
+  std::vector<tsim::CubicPolynomial> laneOffsets;
+  std::vector<tsim::CubicPolynomial> elevations;
+  std::vector<tsim::CubicPolynomial> superelevations;
+
+  std::size_t boundaryCount() const {
+    return widths.size();
+  }
+  // lateral offsets of all boundaries at n ascending s, boundary j at out[j * n]. The widths of all
+  // lanes are evaluated for the whole batch, boundaries are their prefix sums from the center lane
+  // outwards.
+  void evaluateOffsets(const double* s, std::size_t n, double* out) const;
+  // bound of the absolute offsets in the section, exact for constant widths
+  double maxOffset() const;
+  // longest step along the reference line for which the chord error caused by curved offsets and
+  // road profiles stays below the tolerance, 0 for no limit
+  double maxStep(double tolerance) const;
+  // s where an offset or a profile has a kink or jump
+  std::vector<double> breaks() const;
+};
+// layout of the section at section_index of the road, the section ends where the next one starts
+BoundaryLayout layoutLaneBoundaries(const RoadRecord& road, std::size_t section_index);
+
+// reference line samples of a lane section that satisfy the layout (see sampleReferenceLine), with
+// the road profiles applied
+ReferenceLine sampleLaneSection(const std::vector<GeometryRecord>& plan_view,
+                                const BoundaryLayout& layout, double tolerance);
+
+// Lane boundaries of one lane section, calculated on demand. Keeps only the geometries of the
+// planView that overlap the section and the boundary layout.
+class LaneSectionGeometry : public tsim::BoundaryGenerator {
+public:
+  LaneSectionGeometry(const std::vector<GeometryRecord>& plan_view, BoundaryLayout layout,
+                      double tolerance);
+
+  std::size_t boundaryCount() const override {
+    return m_layout.boundaryCount();
+  }
+  std::vector<std::vector<tsim::Point>> boundaries() const override;
+
+private:
+  std::vector<GeometryRecord> m_planView;
+  BoundaryLayout m_layout;
+  double m_tolerance{0};
+};
+
+}  // namespace parser
+
+#endif  // __OPENDRIVE_GEOMETRY_HPP__
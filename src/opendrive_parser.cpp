@@ -2,536 +2,1230 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
+#include <string_view>
 #include <type_traits>
 
+#include "opendrive_geometry.hpp"
+#include "tsim_frenet.hpp"
+#include "tsim_geometry_cache.hpp"
+#include "tsim_lane_index.hpp"
 #include "tsim_map.hpp"
+#include "tsim_map_cache.hpp"
+#include "tsim_mapped_file.hpp"
+#include "tsim_thread_pool.hpp"
 #include "tsim_util.hpp"
 
 namespace parser {
 
-std::shared_ptr<tsim::Map> OpenDriveParser::parse(const std::string& filename) {
-  tinyxml2::XMLError eResult = m_xmlDoc.LoadFile(filename.c_str());
-  if (eResult != tinyxml2::XML_SUCCESS) {
-    if (eResult == tinyxml2::XML_ERROR_FILE_NOT_FOUND) {
-      throw std::runtime_error("File not found!");
+namespace {
+RoadLinkRecord readRoadLink(const XmlTag& odrLink) {
+  RoadLinkRecord link;
+  if (odrLink.attribute("elementType").value_or("") == "junction") {
+    link.elementType = ElementType::eJUNCTION;
+  }
+  link.elementId = odrLink.unsignedAttribute("elementId");
+  return link;
+}
+
+// width, laneOffset, elevation, superelevation: a + b ds + c ds^2 + d ds^3 from s_attribute
+tsim::CubicPolynomial readPolynomial(const XmlTag& element, std::string_view s_attribute) {
+  tsim::CubicPolynomial polynomial;
+  polynomial.sOffset = element.doubleAttribute(s_attribute);
+  polynomial.a = element.doubleAttribute("a");
+  polynomial.b = element.doubleAttribute("b");
+  polynomial.c = element.doubleAttribute("c");
+  polynomial.d = element.doubleAttribute("d");
+  return polynomial;
+}
+
+// pieces are expected in the order of s, restore it for files that do not follow the standard
+void sortPieces(std::vector<tsim::CubicPolynomial>* pieces) {
+  std::stable_sort(pieces->begin(), pieces->end(),
+                   [](const tsim::CubicPolynomial& a, const tsim::CubicPolynomial& b) {
+                     return a.sOffset < b.sOffset;
+                   });
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+    .count();
+}
+
+// default in-flight window per thread (see ParserOptions::inFlightRoads)
+constexpr std::size_t ROADS_PER_THREAD{8};
+// the part of the file that was read is released in steps of this size
+constexpr std::size_t RELEASE_BYTES{1 << 20};
+// parallel read: chunks per thread and smallest chunk
+constexpr std::size_t CHUNKS_PER_THREAD{4};
+constexpr std::size_t MIN_CHUNK_BYTES{64 << 10};
+// OpenDRIVE 1.x, see parseHeader
+constexpr uint32_t SUPPORTED_REV_MAJOR{1};
+
+// offset of the first <road> or <junction> start tag in [from, end), end if there is none. Both
+// elements only appear as children of <OpenDRIVE>, the document continues after end.
+std::size_t findTopLevelElement(std::string_view document, std::size_t from, std::size_t end) {
+  std::size_t result = end;
+  for (std::string_view tag : {std::string_view("<road"), std::string_view("<junction")}) {
+    for (auto pos = document.find(tag, from); pos < result; pos = document.find(tag, pos + 1)) {
+      // not a longer name such as <roadMark>
+      char next = document[pos + tag.size()];
+      if (next == ' ' || next == '\t' || next == '\n' || next == '\r' || next == '>') {
+        result = pos;
+        break;
+      }
     }
-    throw std::runtime_error("File could not be loaded!");
   }
-  auto* odr = m_xmlDoc.FirstChildElement("OpenDRIVE");
-  if (odr == nullptr) {
-    throw std::runtime_error("OpenDRIVE element not found");
+  return result;
+}
+
+// scans up to the <OpenDRIVE> start tag, the scanner is left at the first child
+XmlTag findOpenDrive(XmlScanner* scanner) {
+  XmlTag odr;
+  while (scanner->next(&odr)) {
+    if (odr.kind != XmlTag::Kind::eEND && odr.is("OpenDRIVE")) return odr;
   }
+  throw std::runtime_error("OpenDRIVE element not found");
+}
 
-  parseHeader();
-  parseRoads();
-  parseJunctions();
-  roadConnections();
-  parseLaneSections();
-  parseLanes();
-  laneConnections();
+// fn(is_road, id, text, hash) for every top level road and junction element, their children are
+// skipped. hash is the hash of the element text as in RoadRecord::sourceHash.
+template <typename Fn> void forEachElement(XmlScanner* scanner, const XmlTag& odr, Fn fn) {
+  XmlTag element;
+  while (scanner->nextChild(odr, &element)) {
+    bool isRoad = element.is("road");
+    if (!isRoad && !element.is("junction")) continue;
+    auto id = element.unsignedAttribute("id");
+    XmlTag child;
+    while (scanner->nextChild(element, &child)) {
+    }
+    auto text = scanner->elementText(element);
+    fn(isRoad, id, text, tsim::util::hash64(text.data(), text.size()));
+  }
+}
 
-  return m_mapBuilder.getMap();
+// tiled map: road ends closer than this and with headings within SEAM_HEADING are connected. Lanes
+// on both sides of a seam are matched by the distance of their centers.
+constexpr double SEAM_DISTANCE{0.1};
+constexpr double SEAM_HEADING{0.01};
+constexpr double SEAM_LANE_DISTANCE{0.5};
+
+// moves the ids of a record into the namespace of the tile and its geometry into the map frame
+void moveToTile(const MapTile& tile, RoadRecord* record) {
+  record->id += tile.idOffset;
+  if (record->junction != -1) record->junction += static_cast<int>(tile.idOffset);
+  for (auto* link : {&record->predecessor, &record->successor}) {
+    if (*link) (*link)->elementId += tile.idOffset;
+  }
+  for (auto& geom : record->planView) {
+    geom.x += tile.x;
+    geom.y += tile.y;
+  }
+  if (tile.z != 0 && record->elevations.empty()) {
+    record->elevations.push_back(tsim::CubicPolynomial{});
+  }
+  for (auto& elevation : record->elevations) {
+    elevation.a += tile.z;
+  }
 }
 
-void OpenDriveParser::parseHeader() {
-  auto odr = m_xmlDoc.FirstChildElement("OpenDRIVE");
-  auto rev_major = odr->FirstChildElement("header")->UnsignedAttribute("revMajor");
-  auto rev_minor = odr->FirstChildElement("header")->UnsignedAttribute("revMinor");
-}
-
-void OpenDriveParser::parseRoads() {
-  auto odr = m_xmlDoc.FirstChildElement("OpenDRIVE");
-
-  for (auto* odrRoad = odr->FirstChildElement("road"); odrRoad != nullptr;
-       odrRoad = odrRoad->NextSiblingElement("road")) {
-    // add each road to map
-    auto road =
-      m_mapBuilder.addRoad(odrRoad->UnsignedAttribute("id"), odrRoad->IntAttribute("junction"));
-    // calculate road geometries
-    calculateRoadPoints(road.get(), odrRoad);
-  }
-}
-void OpenDriveParser::parseJunctions() {
-  auto* odr = m_xmlDoc.FirstChildElement("OpenDRIVE");
-  for (auto* odrJunction = odr->FirstChildElement("junction"); odrJunction != nullptr;
-       odrJunction = odrJunction->NextSiblingElement("junction")) {
-    // add each junction to map
-    auto junction = m_mapBuilder.addJunction(odrJunction->UnsignedAttribute("id"));
-    for (auto* odrConnection = odrJunction->FirstChildElement("connection");
-         odrConnection != nullptr;
-         odrConnection = odrConnection->NextSiblingElement("connection")) {
-      // add junction connections
-      auto connection = m_mapBuilder.junction_addConnection(
-        junction.get(), odrConnection->UnsignedAttribute("incomingRoad"),
-        odrConnection->UnsignedAttribute("connectingRoad"));
-      // add lane links
-      for (auto* odrLaneLink = odrConnection->FirstChildElement("laneLink"); odrLaneLink != nullptr;
-           odrLaneLink = odrLaneLink->NextSiblingElement("laneLink")) {
-        int from = odrLaneLink->IntAttribute("from");
-        int to = odrLaneLink->IntAttribute("to");
-        m_mapBuilder.connection_addLaneLink(connection.get(), from, to);
-      }
+void moveToTile(const MapTile& tile, JunctionRecord* record) {
+  record->id += tile.idOffset;
+  for (auto& connection : record->connections) {
+    connection.incomingRoad += tile.idOffset;
+    connection.connectingRoad += tile.idOffset;
+  }
+}
+
+// grid cell of a seam point, neighbouring cells hold all points within SEAM_DISTANCE
+uint64_t seamCell(int64_t x, int64_t y) {
+  return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y);
+}
+
+// frees everything of a record that is not needed for link fixup
+void releaseGeometry(RoadRecord* record) {
+  std::vector<GeometryRecord>().swap(record->planView);
+  std::vector<tsim::CubicPolynomial>().swap(record->laneOffsets);
+  std::vector<tsim::CubicPolynomial>().swap(record->elevations);
+  std::vector<tsim::CubicPolynomial>().swap(record->superelevations);
+  for (auto& section : record->sections) {
+    for (auto& lane : section.lanes) {
+      std::vector<tsim::CubicPolynomial>().swap(lane.widths);
     }
   }
 }
-void OpenDriveParser::roadConnections() {
-  // populate road successors/predecessors
-  auto* odr = m_xmlDoc.FirstChildElement("OpenDRIVE");
-  for (auto* odrRoad = odr->FirstChildElement("road"); odrRoad != nullptr;
-       odrRoad = odrRoad->NextSiblingElement("road")) {
-    auto road = m_mapBuilder.getRoad(odrRoad->UnsignedAttribute("id"));
-
-    auto* odrPredecessor = odrRoad->FirstChildElement("link")->FirstChildElement("predecessor");
-    if (odrPredecessor != nullptr) {
-      // check if road is found, if not, predecessor is a junction
-      auto predecessor = m_mapBuilder.getRoad(odrPredecessor->UnsignedAttribute("elementId"));
-      if (predecessor) {
-        m_mapBuilder.road_addPredecessor(road.get(), predecessor);
-      } else {  // predecessor is a junction
-        auto junction = m_mapBuilder.getJunction(odrPredecessor->UnsignedAttribute("elementId"));
-        auto roads = m_mapBuilder.junction_findConnectingRoads(junction.get(), road.get());
-        for (const auto& predecessors : roads) {
-          m_mapBuilder.road_addPredecessor(road.get(), predecessors);
+}  // namespace
+
+std::shared_ptr<tsim::Map> OpenDriveParser::parse(const std::string& filename) {
+  if (!m_options.mapCache) {
+    return parseFile(filename);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t sourceHash{0};
+  {
+    tsim::MappedFile source(filename);
+    sourceHash = tsim::util::hash64(source.data(), source.size());
+    // the cached points depend on the tessellation settings as well
+    sourceHash = tsim::util::hash64(&m_options.tolerance, sizeof(m_options.tolerance), sourceHash);
+  }
+  auto cacheFilename = filename + ".tsimmap";
+  if (auto map = tsim::MapCache::load(cacheFilename, sourceHash)) {
+    m_statistics = LoadStatistics{};
+    m_statistics.fromCache = true;
+    m_statistics.tolerance = m_options.tolerance;
+    hashElements(filename);
+    m_statistics.roads = map->roads().size();
+    m_statistics.junctions = map->junctions().size();
+    for (const auto& road : map->roads()) {
+      m_statistics.laneSections += road.sections().size();
+      m_statistics.points += road.points().size();
+      for (const auto& section : road.sections()) {
+        m_statistics.lanes += section.lanes().size();
+        for (std::size_t i = 0; i < section.boundaryCount(); i++) {
+          m_statistics.points += section.boundary(i).size();
         }
       }
     }
-    // check if road is found, if not, predecessor is a junction
-    auto* odrSuccessor = odrRoad->FirstChildElement("link")->FirstChildElement("successor");
-    if (odrSuccessor != nullptr) {
-      auto successor = m_mapBuilder.getRoad(odrSuccessor->UnsignedAttribute("elementId"));
-      if (successor) {
-        m_mapBuilder.road_addSuccessor(road.get(), successor);
-      } else {  // predecessor is a junction
-        auto junction = m_mapBuilder.getJunction(odrSuccessor->UnsignedAttribute("elementId"));
-        auto roads = m_mapBuilder.junction_findConnectingRoads(junction.get(), road.get());
-        for (const auto& successors : roads) {
-          m_mapBuilder.road_addSuccessor(road.get(), successors);
-        }
-      }
+    if (m_options.laneIndex || m_options.frenetTable) {
+      tsim::ThreadPool pool(m_options.threads);
+      m_mapBuilder.editMap(map);
+      if (m_options.laneIndex) buildLaneIndex(&pool);
+      if (m_options.frenetTable) buildFrenetTable(&pool);
+      m_mapBuilder.getMap();
     }
+    m_statistics.totalMs = msSince(start);
+    return map;
+  }
+
+  // no valid cache for this file: parse and compile it for the next start
+  auto map = parseFile(filename);
+  try {
+    tsim::MapCache::save(*map, cacheFilename, sourceHash);
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
   }
+  return map;
 }
 
-void OpenDriveParser::calculateRoadPoints(tsim::Road* road, const tinyxml2::XMLElement* odr_road) {
-  const auto* planView = odr_road->FirstChildElement("planView");
-  for (const auto* geom = planView->FirstChildElement("geometry"); geom != nullptr;
-       geom = geom->NextSiblingElement("geometry")) {
-    auto s = geom->DoubleAttribute("s");
-    auto x = geom->DoubleAttribute("x");
-    auto y = geom->DoubleAttribute("y");
-    auto hdg = geom->DoubleAttribute("hdg");
-    auto length = geom->DoubleAttribute("length");
+void OpenDriveParser::hashElements(const std::string& filename) {
+  m_roadHashes.clear();
+  m_junctionHashes.clear();
+  tsim::MappedFile file(filename);
+  XmlScanner scanner(file.view());
+  XmlTag odr = findOpenDrive(&scanner);
+  forEachElement(&scanner, odr, [this](bool is_road, uint32_t id, std::string_view, uint64_t hash) {
+    (is_road ? m_roadHashes : m_junctionHashes)[id] = hash;
+  });
+}
 
-    // TODO: spiral, poly3 (deprecated), parampoly3
-    const auto* arc = geom->FirstChildElement("arc");
+std::shared_ptr<tsim::Map> OpenDriveParser::parseFile(const std::string& filename) {
+  auto start = std::chrono::steady_clock::now();
+  m_statistics = LoadStatistics{};
+  m_statistics.tolerance = m_options.tolerance;
+  m_roadHashes.clear();
+  m_junctionHashes.clear();
 
-    std::vector<tsim::Point> points;
-    if (arc != nullptr) {
-      // Road geometry is an Arc.
-      points = calculateArc(x, y, hdg, length, arc->DoubleAttribute("curvature"));
-    } else {
-      // Road geometry is a Straight.
-      points = calculateStraight(x, y, hdg, length);
-    }
-    // add points for this geometry to road description
-    m_mapBuilder.road_addRoadPoints(road, points);
+  // the file is mapped and scanned in place, no document tree is built
+  tsim::MappedFile file(filename);
+  m_statistics.fileBytes = file.size();
+  XmlScanner scanner(file.view());
+  XmlTag odr = findOpenDrive(&scanner);
+
+  if (m_options.lazyGeometry) {
+    m_mapBuilder.setGeometryCache(
+      std::make_shared<tsim::GeometryCache>(m_options.maxResidentPoints));
   }
+  m_statistics.readMs = msSince(start);
+  m_pending.clear();
+  tsim::ThreadPool pool(m_options.threads);
+  m_statistics.threads = pool.size() + 1;
+  if (m_options.parallelRead) {
+    std::vector<ParsedChunk> chunks;
+    splitDocument(file.view(), scanner.position(), &chunks);
+    readChunks(&chunks, &pool);
+  } else {
+    readElements(&scanner, odr, &pool, &file);
+  }
+  m_statistics.pipelineMs = msSince(start);
+
+  linkRoads(&pool);
+  if (m_options.laneIndex) buildLaneIndex(&pool);
+  if (m_options.frenetTable) buildFrenetTable(&pool);
+  m_statistics.totalMs = msSince(start);
+
+  return m_mapBuilder.getMap();
 }
 
-void OpenDriveParser::parseLaneSections() {
-  auto* odr = m_xmlDoc.FirstChildElement("OpenDRIVE");
-  for (auto* odrRoad = odr->FirstChildElement("road"); odrRoad != nullptr;
-       odrRoad = odrRoad->NextSiblingElement("road")) {
-    auto road = m_mapBuilder.getRoad(odrRoad->UnsignedAttribute("id"));
-    auto* odrLanes = odrRoad->FirstChildElement("lanes");
-    for (auto* odrLaneSection = odrLanes->FirstChildElement("laneSection");
-         odrLaneSection != nullptr;
-         odrLaneSection = odrLaneSection->NextSiblingElement("laneSection")) {
-      // add all lane sections to map
-      std::shared_ptr<tsim::LaneSection> laneSection =
-        m_mapBuilder.road_addLaneSection(road, odrLaneSection->DoubleAttribute("s"));
+std::shared_ptr<tsim::Map> OpenDriveParser::parse(const std::vector<MapTile>& tiles) {
+  auto start = std::chrono::steady_clock::now();
+  m_statistics = LoadStatistics{};
+  m_statistics.tolerance = m_options.tolerance;
+  m_statistics.tiles = tiles.size();
+  m_roadHashes.clear();
+  m_junctionHashes.clear();
+
+  if (m_options.lazyGeometry) {
+    m_mapBuilder.setGeometryCache(
+      std::make_shared<tsim::GeometryCache>(m_options.maxResidentPoints));
+  }
+  tsim::ThreadPool pool(m_options.threads);
+  m_statistics.threads = pool.size() + 1;
+
+  // the chunks of all tiles go into one parallel read, a large tile does not wait for small ones
+  std::vector<tsim::MappedFile> files;
+  files.reserve(tiles.size());
+  std::vector<ParsedChunk> chunks;
+  for (const auto& tile : tiles) {
+    files.emplace_back(tile.filename);
+    m_statistics.fileBytes += files.back().size();
+    XmlScanner scanner(files.back().view());
+    findOpenDrive(&scanner);
+    std::size_t first = chunks.size();
+    splitDocument(files.back().view(), scanner.position(), &chunks);
+    for (std::size_t i = first; i < chunks.size(); i++) chunks[i].tile = &tile;
+  }
+  m_statistics.readMs += msSince(start);
+  readChunks(&chunks, &pool);
+  m_statistics.pipelineMs = msSince(start);
+
+  auto stitchStart = std::chrono::steady_clock::now();
+  stitchTiles();
+  m_statistics.linkMs = msSince(stitchStart);
+  linkRoads(&pool);
+  if (m_options.laneIndex) buildLaneIndex(&pool);
+  if (m_options.frenetTable) buildFrenetTable(&pool);
+  // the ids of the hashes are shifted by the tiles, a tiled map is not reloaded
+  m_roadHashes.clear();
+  m_junctionHashes.clear();
+  m_statistics.totalMs = msSince(start);
+
+  return m_mapBuilder.getMap();
+}
+
+void OpenDriveParser::reload(const std::string& filename, const std::shared_ptr<tsim::Map>& map,
+                             std::shared_mutex* step_mutex) {
+  // without the hashes of the loaded elements every road would be read and added again
+  if (m_roadHashes.empty() && m_junctionHashes.empty() && !map->roads().empty()) {
+    throw std::invalid_argument("map was not loaded from a single file by this parser");
+  }
+  auto start = std::chrono::steady_clock::now();
+  m_statistics = LoadStatistics{};
+  m_statistics.tolerance = m_options.tolerance;
+  tsim::MappedFile file(filename);
+  m_statistics.fileBytes = file.size();
+  XmlScanner scanner(file.view());
+  XmlTag odr = findOpenDrive(&scanner);
+  m_mapBuilder.editMap(map);
+  m_roads.clear();  // left behind by a failed reload
+  m_laneLinkIndex.clear();
+
+  // top level elements are only hashed, unchanged elements are not read. Elements are compared by
+  // id, a changed id is a removed and an added element.
+  std::unordered_map<uint32_t, std::string_view> roadTexts;
+  std::vector<std::string_view> changed;
+  std::vector<JunctionRecord> junctions;
+  std::unordered_set<uint32_t> junctionIds;
+  forEachElement(&scanner, odr, [&](bool is_road, uint32_t id, std::string_view text,
+                                    uint64_t hash) {
+    auto& hashes = is_road ? m_roadHashes : m_junctionHashes;
+    auto previous = hashes.find(id);
+    bool edited = previous == hashes.end() || previous->second != hash;
+    if (is_road) {
+      roadTexts.emplace(id, text);
+      if (edited) changed.push_back(text);
+      return;
     }
+    junctionIds.insert(id);
+    if (edited) {
+      XmlScanner junctionScanner(text);
+      XmlTag odrJunction;
+      junctionScanner.next(&odrJunction);
+      junctions.push_back(readJunction(&junctionScanner, odrJunction));
+    }
+  });
+  auto readRecord = [this](std::string_view text) {
+    XmlScanner roadScanner(text);
+    XmlTag odrRoad;
+    roadScanner.next(&odrRoad);
+    return readRoad(&roadScanner, odrRoad);
+  };
+
+  // roads whose objects are replaced or removed
+  std::unordered_set<uint32_t> replaced;
+  std::vector<uint32_t> removed;
+  for (auto text : changed) {
+    m_roads.push_back(readRecord(text));
+    replaced.insert(m_roads.back().id);
+  }
+  for (const auto& road : map->roads()) {
+    if (roadTexts.count(road.id())) continue;
+    removed.push_back(road.id());
+    replaced.insert(road.id());
+  }
+  std::vector<uint32_t> removedJunctions;
+  for (const auto& junction : map->junctions()) {
+    if (!junctionIds.count(junction.id())) removedJunctions.push_back(junction.id());
   }
+  m_statistics.readMs = msSince(start);
 
-  // laneSection connections
-  for (auto* odrRoad = odr->FirstChildElement("road"); odrRoad != nullptr;
-       odrRoad = odrRoad->NextSiblingElement("road")) {
-    auto road = m_mapBuilder.getRoad(odrRoad->UnsignedAttribute("id"));
-    auto* odrLanes = odrRoad->FirstChildElement("lanes");
-    std::size_t laneSectionCounter{0};
-    auto laneSections = road->sections();
-    auto roadId = road->id();
-    for (auto* odrLaneSection = odrLanes->FirstChildElement("laneSection");
-         odrLaneSection != nullptr;
-         odrLaneSection = odrLaneSection->NextSiblingElement("laneSection")) {
-      // populate lane section connections
-      if (odrRoad->IntAttribute("junction") == -1) {  // TODO not according to standard
-        // road is not part of a junction. For first lane section, add last lane section of previous
-        // road as precedessor. For last lane section, add first lane section of next road as
-        // successor. Otherwise add prev/next lane section in road as successor.
-        auto laneSection = laneSections.at(laneSectionCounter);
-        if (laneSections.size() == 1) {
-          auto roadPredecessors = road->predecessors();
-          for (const auto& succ : roadPredecessors)
-            m_mapBuilder.laneSection_addPredecessor(laneSection.get(), succ->sections().back());
-          auto roadSuccessors = road->successors();
-          for (const auto& succ : roadSuccessors)
-            m_mapBuilder.laneSection_addSuccessor(laneSection.get(), succ->sections().front());
-        } else if (laneSectionCounter == 0) {
-          m_mapBuilder.laneSection_addSuccessor(laneSection.get(),
-                                                laneSections.at(laneSectionCounter + 1));
-          auto roadPredecessors = road->predecessors();
-          for (const auto& succ : roadPredecessors)
-            m_mapBuilder.laneSection_addPredecessor(laneSection.get(), succ->sections().back());
-        } else if (laneSectionCounter == laneSections.size() - 1) {
-          m_mapBuilder.laneSection_addPredecessor(laneSection.get(),
-                                                  laneSections.at(laneSectionCounter - 1));
-          auto roadSuccessors = road->successors();
-          for (const auto& succ : roadSuccessors)
-            m_mapBuilder.laneSection_addSuccessor(laneSection.get(), succ->sections().front());
-        } else {
-          m_mapBuilder.laneSection_addSuccessor(laneSection.get(),
-                                                laneSections.at(laneSectionCounter + 1));
-          m_mapBuilder.laneSection_addPredecessor(laneSection.get(),
-                                                  laneSections.at(laneSectionCounter - 1));
-        }
-      } else {
-        // road is part of a junction. Add last lane section of previous road as predecessor, first
-        // lane section of subsequent road as successor
-        auto laneSection = laneSections.at(laneSectionCounter);
-        auto roadPredecessors = road->predecessors();
-        for (const auto& succ : roadPredecessors)
-          m_mapBuilder.laneSection_addPredecessor(laneSection.get(), succ->sections().back());
-        auto roadSuccessors = road->successors();
-        for (const auto& succ : roadSuccessors)
-          m_mapBuilder.laneSection_addSuccessor(laneSection.get(), succ->sections().front());
+  // neighbours: roads that link to a replaced road, roads a changed road or junction links to
+  std::unordered_set<uint32_t> relink;
+  auto addNeighbour = [&relink, &replaced, &roadTexts](uint32_t id) {
+    if (!replaced.count(id) && roadTexts.count(id)) relink.insert(id);
+  };
+  for (const auto& road : map->roads()) {
+    for (const auto& links : {road.predecessors(), road.successors()}) {
+      for (const auto& link : links) {
+        if (replaced.count(link.id())) addNeighbour(road.id());
       }
-      laneSectionCounter++;
-    }
-  }
-}
-void OpenDriveParser::parseLanes() {
-  auto* odr = m_xmlDoc.FirstChildElement("OpenDRIVE");
-  for (auto* odrRoad = odr->FirstChildElement("road"); odrRoad != nullptr;
-       odrRoad = odrRoad->NextSiblingElement("road")) {
-    auto road = m_mapBuilder.getRoad(odrRoad->UnsignedAttribute("id"));
-    auto* odrLanes = odrRoad->FirstChildElement("lanes");
-    //
-    std::size_t laneSectionCounter{0};
-    for (auto* odrLaneSection = odrLanes->FirstChildElement("laneSection");
-         odrLaneSection != nullptr;
-         odrLaneSection = odrLaneSection->NextSiblingElement("laneSection")) {
-      auto laneSections = road->sections();
-      auto laneSection = laneSections.at(laneSectionCounter);
-
-      auto* groupLeft = odrLaneSection->FirstChildElement("left");
-      auto* groupRight = odrLaneSection->FirstChildElement("right");
-      if (groupLeft != nullptr) {
-        parseLaneGroup(laneSection, groupLeft);
+    }
+  }
+  auto addConnections = [&addNeighbour](uint32_t incoming, uint32_t connecting) {
+    addNeighbour(incoming);
+    addNeighbour(connecting);
+  };
+  for (const auto& junction : junctions) {
+    for (const auto& connection : junction.connections) {
+      addConnections(connection.incomingRoad, connection.connectingRoad);
+    }
+  }
+  for (auto id : removedJunctions) {
+    for (const auto& connection : m_mapBuilder.getJunction(id)->connections()) {
+      addConnections(connection.incomingRoad(), connection.connectingRoad());
+    }
+  }
+  for (std::size_t i = 0; i < changed.size(); i++) {
+    for (const auto& link : {m_roads[i].predecessor, m_roads[i].successor}) {
+      if (!link) continue;
+      if (link->elementType == ElementType::eROAD) {
+        addNeighbour(link->elementId);
+        continue;
       }
-      if (groupRight != nullptr) {
-        parseLaneGroup(laneSection, groupRight);
+      // connecting roads of a junction the road ends in, from the road or towards it
+      const auto* junction = m_mapBuilder.getJunction(link->elementId);
+      if (!junction) continue;
+      for (const auto& connection : junction->connections()) {
+        addNeighbour(connection.connectingRoad());
       }
+    }
+  }
+  for (auto id : relink) m_roads.push_back(readRecord(roadTexts.at(id)));
+
+  // changed roads are tessellated aside, the map is not modified yet
+  tsim::ThreadPool pool(m_options.threads);
+  m_statistics.threads = pool.size() + 1;
+  auto tessellateStart = std::chrono::steady_clock::now();
+  std::vector<TessellatedRoad> results(changed.size());
+  pool.parallelFor(changed.size(), [this, &results](std::size_t i) {
+    results[i] = tessellateRoad(m_roads[i]);
+  });
+  m_statistics.tessellateMs = msSince(tessellateStart);
 
-      laneSectionCounter++;
+  // swap: adding objects moves the arrays of the map, readers are paused from here on. The new
+  // objects take the place of the old ones, the neighbours are linked again.
+  auto swapStart = std::chrono::steady_clock::now();
+  {
+    std::unique_lock<std::shared_mutex> lock;
+    if (step_mutex) lock = std::unique_lock<std::shared_mutex>(*step_mutex);
+    for (std::size_t i = 0; i < changed.size(); i++) buildRoad(m_roads[i]);
+    for (const auto& junction : junctions) buildJunction(junction);
+    for (auto id : removed) {
+      m_mapBuilder.removeRoad(id);
+      m_roadHashes.erase(id);
     }
+    for (auto id : removedJunctions) {
+      m_mapBuilder.removeJunction(id);
+      m_junctionHashes.erase(id);
+    }
+    for (std::size_t i = 0; i < changed.size(); i++) addTessellation(&m_roads[i], &results[i]);
+
+    // lane links of the unchanged junctions the roads lead into, changed ones are indexed when
+    // built
+    std::unordered_set<uint32_t> indexed;
+    for (const auto& junction : junctions) indexed.insert(junction.id);
+    for (const auto& record : m_roads) {
+      for (const auto& link : {record.predecessor, record.successor}) {
+        if (!link || link->elementType != ElementType::eJUNCTION) continue;
+        const auto* junction = m_mapBuilder.getJunction(link->elementId);
+        if (junction && indexed.insert(link->elementId).second) indexLaneLinks(*junction);
+      }
+    }
+
+    m_mapBuilder.commit();
+    for (std::size_t i = changed.size(); i < m_roads.size(); i++) {
+      m_mapBuilder.road_clearLinks(m_mapBuilder.getRoad(m_roads[i].id)->handle());
+    }
+    linkPasses(&pool);
+  }
+  m_statistics.swapMs = msSince(swapStart);
+  m_statistics.linkMs = m_statistics.swapMs;
+  // the lane index is built from the changed map while the simulation continues and swapped in
+  // like the roads
+  if (auto laneIndex = map->laneIndex()) {
+    auto indexStart = std::chrono::steady_clock::now();
+    auto rebuilt = std::make_shared<tsim::LaneIndex>(*map, laneIndex->options(), &pool);
+    std::unique_lock<std::shared_mutex> lock;
+    if (step_mutex) lock = std::unique_lock<std::shared_mutex>(*step_mutex);
+    m_mapBuilder.setLaneIndex(std::move(rebuilt));
+    m_statistics.laneIndexMs = msSince(indexStart);
   }
+  // the tables of the lanes added by the reload, the replaced lanes keep theirs. Vehicles entering
+  // a new lane before the swap step along the road (see tsim::Vehicle::drive).
+  if (auto frenetTable = map->frenetTable()) {
+    auto frenetStart = std::chrono::steady_clock::now();
+    auto extended = std::make_shared<tsim::FrenetTable>(*map, *frenetTable, &pool);
+    std::unique_lock<std::shared_mutex> lock;
+    if (step_mutex) lock = std::unique_lock<std::shared_mutex>(*step_mutex);
+    m_mapBuilder.setFrenetTable(std::move(extended));
+    m_statistics.frenetMs = msSince(frenetStart);
+  }
+  m_statistics.changedRoads = changed.size();
+  m_statistics.relinkedRoads = relink.size();
+  m_statistics.removedRoads = removed.size();
+  m_roads.clear();
+  m_laneLinkIndex.clear();
+  m_mapBuilder.getMap();  // ends editing, the caller keeps the map
+  m_statistics.totalMs = msSince(start);
 }
-void OpenDriveParser::laneConnections() {
-  auto* odr = m_xmlDoc.FirstChildElement("OpenDRIVE");
-  // populate lane successors/predecessors
-  for (auto* odrRoad = odr->FirstChildElement("road"); odrRoad != nullptr;
-       odrRoad = odrRoad->NextSiblingElement("road")) {
-    auto road = m_mapBuilder.getRoad(odrRoad->UnsignedAttribute("id"));
-    auto* odrLanes = odrRoad->FirstChildElement("lanes");
-    std::size_t laneSectionCounter{0};
-    for (auto* odrLaneSection = odrLanes->FirstChildElement("laneSection");
-         odrLaneSection != nullptr;
-         odrLaneSection = odrLaneSection->NextSiblingElement("laneSection")) {
-      auto laneSections = road->sections();
-      auto laneSection = laneSections.at(laneSectionCounter);
-      auto* groupLeft = odrLaneSection->FirstChildElement("left");
-      auto* groupRight = odrLaneSection->FirstChildElement("right");
-
-      if (groupLeft != nullptr) {
-        laneConnections(laneSection, groupLeft);
+
+void OpenDriveParser::readElements(XmlScanner* scanner, const XmlTag& odr, tsim::ThreadPool* pool,
+                                   tsim::MappedFile* file) {
+  std::size_t window = m_options.inFlightRoads;
+  if (window == 0) window = ROADS_PER_THREAD * m_statistics.threads;
+  std::size_t released{0};
+
+  // single traversal: every top level element is visited exactly once. Roads are added to the map
+  // together with their lane sections and lanes, links are kept as plain ids. Worker threads
+  // tessellate the roads read so far, this thread adds their points to the map once the window is
+  // full.
+  auto readStart = std::chrono::steady_clock::now();
+  XmlTag element;
+  while (scanner->nextChild(odr, &element)) {
+    if (element.is("road")) {
+      m_roads.push_back(readRoad(scanner, element));
+      buildRoad(m_roads.back());
+      m_statistics.readMs += msSince(readStart);
+      submitRoad(pool, &m_roads.back());
+      m_statistics.maxInFlight = std::max(m_statistics.maxInFlight, m_pending.size());
+      while (m_pending.size() >= window) mergeRoad();
+      // records do not point into the file, the part that was read is not needed anymore
+      if (scanner->position() >= released + RELEASE_BYTES) {
+        released = scanner->position();
+        file->release(released);
+      }
+      readStart = std::chrono::steady_clock::now();
+    } else if (element.is("junction")) {
+      buildJunction(readJunction(scanner, element));
+    } else if (element.is("header")) {
+      parseHeader(element);
+    }
+  }
+  m_statistics.readMs += msSince(readStart);
+  while (!m_pending.empty()) mergeRoad();
+}
+
+void OpenDriveParser::splitDocument(std::string_view document, std::size_t body_begin,
+                                    std::vector<ParsedChunk>* chunks) {
+  auto prescanStart = std::chrono::steady_clock::now();
+  std::size_t bodyEnd = document.rfind("</OpenDRIVE");
+  if (bodyEnd == std::string_view::npos || bodyEnd < body_begin) {
+    throw std::runtime_error("OpenDRIVE element not closed");
+  }
+  // the body is split evenly, every split moves forward to the next road or junction. Several
+  // chunks per thread balance roads of different complexity.
+  std::size_t bodySize = bodyEnd - body_begin;
+  std::size_t count =
+    std::min(CHUNKS_PER_THREAD * m_statistics.threads, bodySize / MIN_CHUNK_BYTES);
+  chunks->emplace_back();
+  chunks->back().document = document;
+  chunks->back().begin = body_begin;
+  for (std::size_t i = 1; i < count; i++) {
+    auto split = findTopLevelElement(document, body_begin + bodySize * i / count, bodyEnd);
+    if (split <= chunks->back().begin) continue;
+    chunks->back().end = split;
+    chunks->emplace_back();
+    chunks->back().document = document;
+    chunks->back().begin = split;
+  }
+  chunks->back().end = bodyEnd;
+  m_statistics.readMs += msSince(prescanStart);
+}
+
+void OpenDriveParser::readChunks(std::vector<ParsedChunk>* chunks, tsim::ThreadPool* pool) {
+  m_statistics.chunks = chunks->size();
+  pool->parallelFor(chunks->size(), [this, chunks](std::size_t i) {
+    parseChunk(&(*chunks)[i]);
+  });
+
+  // merged in document order, the map is the same as with a single reader
+  auto mergeStart = std::chrono::steady_clock::now();
+  for (auto& chunk : *chunks) {
+    m_statistics.readMs += chunk.readMs;
+    m_statistics.tessellateMs += chunk.tessellateMs;
+    for (std::size_t i = 0; i < chunk.roads.size(); i++) {
+      if (chunk.tile) {
+        // ids of separately produced tiles may collide, the builder's index would hide the road
+        if (m_mapBuilder.getRoad(chunk.roads[i].id)) {
+          throw std::runtime_error("road " + std::to_string(chunk.roads[i].id) + " of " +
+                                   chunk.tile->filename + " is defined in several tiles");
+        }
+        m_roadTiles.push_back(chunk.tile);
       }
-      if (groupRight != nullptr) {
-        laneConnections(laneSection, groupRight);
+      m_roads.push_back(std::move(chunk.roads[i]));
+      buildRoad(m_roads.back());
+      addTessellation(&m_roads.back(), &chunk.results[i]);
+    }
+    for (const auto& junction : chunk.junctions) {
+      buildJunction(junction);
+    }
+    chunk = ParsedChunk{};  // release memory early
+  }
+  m_statistics.mergeMs += msSince(mergeStart);
+}
+
+void OpenDriveParser::parseChunk(ParsedChunk* chunk) const {
+  auto start = std::chrono::steady_clock::now();
+  // the chunk holds complete top level elements only, its scanner starts at depth 0
+  XmlScanner scanner(chunk->document.substr(chunk->begin, chunk->end - chunk->begin));
+  XmlTag element;
+  while (scanner.next(&element)) {
+    if (element.is("road")) {
+      chunk->roads.push_back(readRoad(&scanner, element));
+      if (chunk->tile) moveToTile(*chunk->tile, &chunk->roads.back());
+    } else if (element.is("junction")) {
+      chunk->junctions.push_back(readJunction(&scanner, element));
+      if (chunk->tile) moveToTile(*chunk->tile, &chunk->junctions.back());
+    } else {
+      if (element.is("header")) parseHeader(element);
+      XmlTag child;
+      while (scanner.nextChild(element, &child)) {
       }
-      laneSectionCounter++;
-    }
-  }
-}
-
-void OpenDriveParser::parseLaneGroup(std::shared_ptr<tsim::LaneSection> lane_section,
-                                     const tinyxml2::XMLElement* group) {
-  for (auto* odrLane = group->FirstChildElement("lane"); odrLane != nullptr;
-       odrLane = odrLane->NextSiblingElement("lane")) {
-    // add all lanes to the map
-    auto lane = m_mapBuilder.laneSection_addLane(
-      lane_section, odrLane->IntAttribute("id"),
-      odrLane->FirstChildElement("width")->DoubleAttribute("sOffset"),
-      odrLane->FirstChildElement("width")->DoubleAttribute("a"),
-      parseLaneType(odrLane->Attribute("type")));
-    // calculate lane geometries
-    calculateLaneBoundaryPoints(lane.get(), odrLane);
-    calculateLanePoints(lane.get(), odrLane);
-  }
-}
-
-void OpenDriveParser::laneConnections(std::shared_ptr<tsim::LaneSection> lane_section,
-                                      const tinyxml2::XMLElement* group) {
-  for (auto* odrLane = group->FirstChildElement("lane"); odrLane != nullptr;
-       odrLane = odrLane->NextSiblingElement("lane")) {
-    if (!strcmp(odrLane->Attribute("type"), "driving")) {  // TODO only driving Lanes
-      auto lane = lane_section->lane(odrLane->UnsignedAttribute("id"));
-      // auto road = m_mapBuilder.getRoad(lane_section->road()->id());
-      auto road = lane_section->road();
-      auto road_id = lane_section->road()->id();
-      auto link = odrLane->FirstChildElement("link");
-      if (link) {
-        auto odr_predecessor = link->FirstChildElement("predecessor");
-        if (odr_predecessor) {
-          int id = odr_predecessor->IntAttribute("id");
-          // find predecessor
-          auto lane_section_predecessors = lane_section->predecessors();
-          for (auto elem : lane_section_predecessors) {
-            m_mapBuilder.lane_addPredecessor(lane.get(),
-                                             elem->lane(odr_predecessor->IntAttribute("id")));
-          }
-        } else {
-          // predecessor is a junction
-          auto lane_section_predecessors = lane_section->predecessors();
-          for (auto elem : lane_section_predecessors) {
-            // find the junction it belongs to
-            // auto junction = elem->road()->junction();
-            auto junction = m_mapBuilder.getJunction(elem->road()->junction());
-
-            if (junction) {
-              // check if lane links contain current lane
-              for (auto conn : junction->connections()) {
-                if ((conn->incomingRoad() == lane_section->road()->id()) &&
-                    (conn->connectingRoad() == elem->road()->id())) {
-                  auto lls = conn->getLaneLinks();
-                  std::vector<tsim::LaneLink> res;
-                  std::copy_if(lls.begin(), lls.end(), std::back_inserter(res),
-                               [lane](const tsim::LaneLink& ll) {
-                                 return ll.from == lane->id();
-                               });
-                  for (auto link : res)
-                    m_mapBuilder.lane_addPredecessor(lane.get(), elem->lane(link.to));
-                }
-              }
-            }
-          }
+    }
+  }
+  chunk->readMs = msSince(start);
+
+  auto tessellateStart = std::chrono::steady_clock::now();
+  chunk->results.reserve(chunk->roads.size());
+  for (const auto& road : chunk->roads) {
+    chunk->results.push_back(tessellateRoad(road));
+  }
+  chunk->tessellateMs = msSince(tessellateStart);
+}
+
+void OpenDriveParser::parseHeader(const XmlTag& odrHeader) const {
+  // all 1.x revisions share the elements read here, a missing revision is read as 1.x
+  auto revMajor = odrHeader.unsignedAttribute("revMajor", SUPPORTED_REV_MAJOR);
+  if (revMajor != SUPPORTED_REV_MAJOR) {
+    throw std::runtime_error("OpenDRIVE revision " + std::to_string(revMajor) + "." +
+                             std::to_string(odrHeader.unsignedAttribute("revMinor")) +
+                             " not supported");
+  }
+}
+
+RoadRecord OpenDriveParser::readRoad(XmlScanner* scanner, const XmlTag& odrRoad) const {
+  RoadRecord record;
+  record.id = odrRoad.unsignedAttribute("id");
+  record.junction = odrRoad.intAttribute("junction");
+
+  XmlTag child;
+  while (scanner->nextChild(odrRoad, &child)) {
+    if (child.is("link")) {
+      XmlTag odrLink;
+      while (scanner->nextChild(child, &odrLink)) {
+        if (odrLink.is("predecessor")) {
+          record.predecessor = readRoadLink(odrLink);
+        } else if (odrLink.is("successor")) {
+          record.successor = readRoadLink(odrLink);
         }
-        auto odr_successor = link->FirstChildElement("successor");
-        if (odr_successor) {
-          auto lane_section_successors = lane_section->successors();
-          for (auto elem : lane_section_successors) {
-            m_mapBuilder.lane_addSuccessor(lane.get(),
-                                           elem->lane(odr_successor->IntAttribute("id")));
-          }
-        } else {
-          // check if predecessor is a junction
-          auto lane_section_successors = lane_section->successors();
-          for (auto elem : lane_section_successors) {
-            // find the junction it belongs to
-            // auto junction = elem->road()->junction();
-            auto junction = m_mapBuilder.getJunction(elem->road()->junction());
-            // check if lane links contain current lane i
-            if (junction) {
-              for (auto conn : junction->connections()) {
-                if ((conn->incomingRoad() == lane_section->road()->id()) &&
-                    (conn->connectingRoad() == elem->road()->id())) {
-                  auto lls = conn->getLaneLinks();
-                  std::vector<tsim::LaneLink> res;
-                  std::copy_if(lls.begin(), lls.end(), std::back_inserter(res),
-                               [lane](const tsim::LaneLink& ll) {
-                                 return ll.from == lane->id();
-                               });
-                  for (auto link : res)
-                    m_mapBuilder.lane_addSuccessor(lane.get(), elem->lane(link.to));
-                }
-              }
-            }
-          }
+      }
+    } else if (child.is("planView")) {
+      XmlTag geom;
+      while (scanner->nextChild(child, &geom)) {
+        if (geom.is("geometry")) {
+          record.planView.push_back(readGeometry(scanner, geom));
         }
-      } else {
-        // no link for lane
-        auto lane_section_predecessors = lane_section->predecessors();
-        for (auto elem : lane_section_predecessors) {
-          // find the junction it belongs to
-          // auto junction = elem->road()->junction();
-
-          auto junction = m_mapBuilder.getJunction(elem->road()->junction());
-          // check if lane links contain current lane
-          if (junction) {
-            for (auto conn : junction->connections()) {
-              if ((conn->incomingRoad() == lane_section->road()->id()) &&
-                  (conn->connectingRoad() == elem->road()->id())) {
-                auto lls = conn->getLaneLinks();
-                std::vector<tsim::LaneLink> res;
-                std::copy_if(lls.begin(), lls.end(), std::back_inserter(res),
-                             [lane](const tsim::LaneLink& ll) {
-                               return ll.from == lane->id();
-                             });
-                for (auto link : res)
-                  m_mapBuilder.lane_addPredecessor(lane.get(), elem->lane(link.to));
-              }
-            }
-          }
+      }
+    } else if (child.is("elevationProfile")) {
+      XmlTag odrElevation;
+      while (scanner->nextChild(child, &odrElevation)) {
+        if (odrElevation.is("elevation")) {
+          record.elevations.push_back(readPolynomial(odrElevation, "s"));
+        }
+      }
+    } else if (child.is("lateralProfile")) {
+      // crossfall and shape are ignored
+      XmlTag odrLateral;
+      while (scanner->nextChild(child, &odrLateral)) {
+        if (odrLateral.is("superelevation")) {
+          record.superelevations.push_back(readPolynomial(odrLateral, "s"));
         }
-        auto lane_section_successors = lane_section->successors();
-        for (auto elem : lane_section_successors) {
-          // find the junction it belongs to
-          // auto junction = elem->road()->junction();
-          auto junction = m_mapBuilder.getJunction(elem->road()->junction());
-          // check if lane links contain current lane i
-          if (junction) {
-            for (auto conn : junction->connections()) {
-              if ((conn->incomingRoad() == lane_section->road()->id()) &&
-                  (conn->connectingRoad() == elem->road()->id())) {
-                auto lls = conn->getLaneLinks();
-                std::vector<tsim::LaneLink> res;
-                std::copy_if(lls.begin(), lls.end(), std::back_inserter(res),
-                             [lane](const tsim::LaneLink& ll) {
-                               return ll.from == lane->id();
-                             });
-                for (auto link : res) {
-                  m_mapBuilder.lane_addSuccessor(lane.get(), elem->lane(link.to));
-                }
-              }
-            }
+      }
+    } else if (child.is("lanes")) {
+      XmlTag odrLaneSection;
+      while (scanner->nextChild(child, &odrLaneSection)) {
+        if (odrLaneSection.is("laneSection")) {
+          record.sections.push_back(readLaneSection(scanner, odrLaneSection));
+        } else if (odrLaneSection.is("laneOffset")) {
+          record.laneOffsets.push_back(readPolynomial(odrLaneSection, "s"));
+        }
+      }
+    }
+  }
+  sortPieces(&record.laneOffsets);
+  sortPieces(&record.elevations);
+  sortPieces(&record.superelevations);
+  auto text = scanner->elementText(odrRoad);
+  record.sourceHash = tsim::util::hash64(text.data(), text.size());
+  return record;
+}
+
+GeometryRecord OpenDriveParser::readGeometry(XmlScanner* scanner, const XmlTag& geom) const {
+  GeometryRecord geometry;
+  geometry.s = geom.doubleAttribute("s");
+  geometry.x = geom.doubleAttribute("x");
+  geometry.y = geom.doubleAttribute("y");
+  geometry.hdg = geom.doubleAttribute("hdg");
+  geometry.length = geom.doubleAttribute("length");
+
+  // TODO: poly3 (deprecated)
+  XmlTag shape;
+  while (scanner->nextChild(geom, &shape)) {
+    if (shape.is("arc")) {
+      geometry.type = GeometryType::eARC;
+      geometry.curvature = shape.doubleAttribute("curvature");
+    } else if (shape.is("spiral")) {
+      geometry.type = GeometryType::eSPIRAL;
+      geometry.curvature = shape.doubleAttribute("curvStart");
+      geometry.curvatureEnd = shape.doubleAttribute("curvEnd");
+    } else if (shape.is("paramPoly3")) {
+      geometry.type = GeometryType::ePARAM_POLY3;
+      geometry.u = {shape.doubleAttribute("aU"), shape.doubleAttribute("bU"),
+                    shape.doubleAttribute("cU"), shape.doubleAttribute("dU")};
+      geometry.v = {shape.doubleAttribute("aV"), shape.doubleAttribute("bV"),
+                    shape.doubleAttribute("cV"), shape.doubleAttribute("dV")};
+      geometry.pRange =
+        shape.attribute("pRange").value_or("normalized") == "arcLength" ? geometry.length : 1;
+    }
+  }
+  return geometry;
+}
+
+LaneSectionRecord OpenDriveParser::readLaneSection(XmlScanner* scanner,
+                                                   const XmlTag& odrLaneSection) const {
+  LaneSectionRecord section;
+  section.s = odrLaneSection.doubleAttribute("s");
+
+  // left group first, then right group, independent of the document order
+  std::vector<LaneRecord> right;
+  XmlTag group;
+  while (scanner->nextChild(odrLaneSection, &group)) {
+    if (group.is("left")) {
+      readLaneGroup(scanner, group, &section.lanes);
+    } else if (group.is("right")) {
+      readLaneGroup(scanner, group, &right);
+    }
+  }
+  section.lanes.insert(section.lanes.end(), right.begin(), right.end());
+  return section;
+}
+
+void OpenDriveParser::readLaneGroup(XmlScanner* scanner, const XmlTag& group,
+                                    std::vector<LaneRecord>* lanes) const {
+  XmlTag odrLane;
+  while (scanner->nextChild(group, &odrLane)) {
+    if (!odrLane.is("lane")) continue;
+    LaneRecord lane;
+    lane.id = odrLane.intAttribute("id");
+    lane.type = parseLaneType(odrLane.attribute("type").value_or(""));
+
+    XmlTag child;
+    while (scanner->nextChild(odrLane, &child)) {
+      if (child.is("width")) {
+        lane.widths.push_back(readPolynomial(child, "sOffset"));
+      } else if (child.is("link")) {
+        lane.hasLink = true;
+        XmlTag odrLink;
+        while (scanner->nextChild(child, &odrLink)) {
+          if (odrLink.is("predecessor")) {
+            lane.predecessor = odrLink.intAttribute("id");
+          } else if (odrLink.is("successor")) {
+            lane.successor = odrLink.intAttribute("id");
           }
         }
       }
     }
+    sortPieces(&lane.widths);
+    if (!lane.widths.empty()) lane.sOffset = lane.widths.front().sOffset;
+    lanes->push_back(lane);
   }
 }
 
-void OpenDriveParser::calculateLaneBoundaryPoints(tsim::Lane* lane,
-                                                  const tinyxml2::XMLElement* odrLane) {
-  const auto* odrRoad = odrLane->Parent()->Parent()->Parent()->Parent();
+void OpenDriveParser::buildRoad(const RoadRecord& record) {
+  // add road to map, geometries are calculated in the tessellation stage
+  auto road = m_mapBuilder.addRoad(record.id, record.junction);
+  // the primitives are kept for analytic evaluation (Road::evaluate)
+  for (const auto& geom : record.planView) {
+    m_mapBuilder.road_addSegment(road, toRoadSegment(geom));
+  }
+  double roadEnd = planViewEnd(record.planView);
+  m_mapBuilder.road_setLength(road, roadEnd);
+  for (const auto& laneOffset : record.laneOffsets) {
+    m_mapBuilder.road_addLaneOffset(road, laneOffset);
+  }
+  for (const auto& elevation : record.elevations) {
+    m_mapBuilder.road_addElevation(road, elevation);
+  }
+  for (const auto& superelevation : record.superelevations) {
+    m_mapBuilder.road_addSuperelevation(road, superelevation);
+  }
 
-  auto planView = odrRoad->FirstChildElement("planView");
-  auto offset = lane->width() * tsim::util::sgn(lane->id());
-  for (const auto* geom = planView->FirstChildElement("geometry"); geom != nullptr;
-       geom = geom->NextSiblingElement("geometry")) {
-    auto s = geom->DoubleAttribute("s");
-    auto x = geom->DoubleAttribute("x");
-    auto y = geom->DoubleAttribute("y");
-    auto hdg = geom->DoubleAttribute("hdg");
-    auto length = geom->DoubleAttribute("length");
+  for (std::size_t i = 0; i < record.sections.size(); i++) {
+    const auto& sectionRecord = record.sections[i];
+    auto laneSection = m_mapBuilder.road_addLaneSection(road, sectionRecord.s);
+    double sEnd = i + 1 < record.sections.size() ? record.sections[i + 1].s : roadEnd;
+    m_mapBuilder.laneSection_setLength(laneSection, sEnd - sectionRecord.s);
+    for (const auto& laneRecord : sectionRecord.lanes) {
+      // add all lanes to the map
+      auto lane = m_mapBuilder.laneSection_addLane(laneSection, laneRecord.id, laneRecord.sOffset,
+                                                   laneRecord.type);
+      for (const auto& width : laneRecord.widths) {
+        m_mapBuilder.lane_addWidth(lane, width);
+      }
+    }
+    m_statistics.lanes += sectionRecord.lanes.size();
+  }
+  m_statistics.laneSections += record.sections.size();
+  m_statistics.roads++;
+  m_roadHashes[record.id] = record.sourceHash;
+}
 
-    // line, spiral, arc, poly3, parampoly3
-    const auto* arc = geom->FirstChildElement("arc");
+void OpenDriveParser::submitRoad(tsim::ThreadPool* pool, RoadRecord* record) {
+  // the deque keeps the element in place while further roads are added
+  m_pending.emplace_back();
+  auto* pending = &m_pending.back();
+  pending->record = record;
+  pending->done = pool->submit([this, pending]() {
+    auto start = std::chrono::steady_clock::now();
+    pending->result = tessellateRoad(*pending->record);
+    pending->tessellateMs = msSince(start);
+  });
+}
 
-    std::vector<tsim::Point> points;
-    if (arc != nullptr) {
-      points = calculateArc(x, y, hdg, length, arc->DoubleAttribute("curvature"), offset);
+void OpenDriveParser::mergeRoad() {
+  auto& pending = m_pending.front();
+  auto waitStart = std::chrono::steady_clock::now();
+  pending.done.wait();
+  auto mergeStart = std::chrono::steady_clock::now();
+  m_statistics.stallMs +=
+    std::chrono::duration<double, std::milli>(mergeStart - waitStart).count();
+  pending.done.get();  // rethrows errors of the tessellation
+  addTessellation(pending.record, &pending.result);
+  m_statistics.tessellateMs += pending.tessellateMs;
+  m_pending.pop_front();
+  m_statistics.mergeMs += msSince(mergeStart);
+}
 
-    } else {
-      points = calculateStraight(x, y, hdg, length, offset);
+void OpenDriveParser::addTessellation(RoadRecord* record, TessellatedRoad* result) {
+  const auto* road = m_mapBuilder.getRoad(record->id);
+  m_mapBuilder.road_addRoadPoints(road->handle(), std::move(result->roadPoints));
+  m_statistics.points += road->points().size();
+  auto laneSections = road->sections();
+  for (std::size_t j = 0; j < laneSections.size(); j++) {
+    auto& section = result->sections[j];
+    auto handle = laneSections[j].handle();
+    if (section.geometry) {
+      m_mapBuilder.laneSection_setBoundaryGenerator(handle, std::move(section.geometry));
+    }
+    for (auto& boundary : section.boundaries) {
+      m_statistics.points += boundary.size();
+      m_mapBuilder.laneSection_addBoundary(handle, std::move(boundary));
+    }
+    auto lanes = laneSections[j].lanes();
+    for (std::size_t k = 0; k < lanes.size(); k++) {
+      m_mapBuilder.lane_setBoundaries(lanes[k].handle(), section.laneBoundaries[k].inner,
+                                      section.laneBoundaries[k].outer);
     }
-    m_mapBuilder.lane_addLaneBoundaryPoints(lane, points);
   }
+  m_statistics.clippedPoints += result->clippedPoints;
+  // only the links of the record are needed from here on
+  releaseGeometry(record);
 }
 
-void OpenDriveParser::calculateLanePoints(tsim::Lane* lane, const tinyxml2::XMLElement* odrLane) {
-  const auto* odrRoad = odrLane->Parent()->Parent()->Parent()->Parent();
+TessellatedRoad OpenDriveParser::tessellateRoad(const RoadRecord& record) const {
+  TessellatedRoad result;
+  result.roadPoints = calculateRoadPoints(record);
+  // a boundary along the full reference line has as many points as the road (fixed sampling)
+  std::size_t fullLanePoints{0};
+  std::size_t lanePoints{0};
+  for (std::size_t i = 0; i < record.sections.size(); i++) {
+    auto layout = layoutLaneBoundaries(record, i);
+    TessellatedSection section;
+    section.laneBoundaries = layout.laneBoundaries;
+    if (m_options.lazyGeometry) {
+      // keep the geometry of the section, boundaries are calculated when they are used
+      section.geometry = std::make_shared<LaneSectionGeometry>(record.planView, std::move(layout),
+                                                               m_options.tolerance);
+      result.sections.push_back(std::move(section));
+      continue;
+    }
+    // the reference line is sampled once per section, the offsets of all boundaries are evaluated
+    // for all samples in one batch and applied along the normals
+    auto referenceLine = sampleLaneSection(record.planView, layout, m_options.tolerance);
+    std::size_t samples = referenceLine.size();
+    std::vector<double> offsets(layout.boundaryCount() * samples);
+    layout.evaluateOffsets(referenceLine.s.data(), samples, offsets.data());
+    for (std::size_t j = 0; j < layout.boundaryCount(); j++) {
+      section.boundaries.push_back(
+        calculateOffsetPoints(referenceLine, offsets.data() + j * samples));
+    }
+    result.sections.push_back(std::move(section));
+    // the boundaries stored by the section, each shared by the two lanes along it
+    fullLanePoints += layout.boundaryCount() * result.roadPoints.size();
+    lanePoints += layout.boundaryCount() * samples;
+  }
+  result.clippedPoints = fullLanePoints > lanePoints ? fullLanePoints - lanePoints : 0;
+  return result;
+}
 
-  const auto* planView = odrRoad->FirstChildElement("planView");
-  auto offset = lane->width() * tsim::util::sgn(lane->id());
-  offset = offset / 2;  // half lane width for lane center
-  for (const auto* geom = planView->FirstChildElement("geometry"); geom != nullptr;
-       geom = geom->NextSiblingElement("geometry")) {
-    auto s = geom->DoubleAttribute("s");
-    auto x = geom->DoubleAttribute("x");
-    auto y = geom->DoubleAttribute("y");
-    auto hdg = geom->DoubleAttribute("hdg");
-    auto length = geom->DoubleAttribute("length");
+JunctionRecord OpenDriveParser::readJunction(XmlScanner* scanner,
+                                            const XmlTag& odrJunction) const {
+  JunctionRecord junction;
+  junction.id = odrJunction.unsignedAttribute("id");
+  XmlTag odrConnection;
+  while (scanner->nextChild(odrJunction, &odrConnection)) {
+    if (!odrConnection.is("connection")) continue;
+    ConnectionRecord connection;
+    connection.incomingRoad = odrConnection.unsignedAttribute("incomingRoad");
+    connection.connectingRoad = odrConnection.unsignedAttribute("connectingRoad");
+    XmlTag odrLaneLink;
+    while (scanner->nextChild(odrConnection, &odrLaneLink)) {
+      if (!odrLaneLink.is("laneLink")) continue;
+      connection.laneLinks.push_back(
+        tsim::LaneLink{odrLaneLink.intAttribute("from"), odrLaneLink.intAttribute("to")});
+    }
+    junction.connections.push_back(std::move(connection));
+  }
+  auto text = scanner->elementText(odrJunction);
+  junction.sourceHash = tsim::util::hash64(text.data(), text.size());
+  return junction;
+}
 
-    // line, spiral, arc, poly3, parampoly3
-    const auto* arc = geom->FirstChildElement("arc");
+void OpenDriveParser::buildJunction(const JunctionRecord& record) {
+  // add junction with its connections and lane links to the map
+  auto junction = m_mapBuilder.addJunction(record.id);
+  for (const auto& connectionRecord : record.connections) {
+    auto connection = m_mapBuilder.junction_addConnection(
+      junction, connectionRecord.incomingRoad, connectionRecord.connectingRoad);
+    for (const auto& laneLink : connectionRecord.laneLinks) {
+      m_mapBuilder.connection_addLaneLink(connection, laneLink.from, laneLink.to);
+      LaneLinkKey key{static_cast<int32_t>(record.id), connectionRecord.incomingRoad,
+                      connectionRecord.connectingRoad, laneLink.from};
+      m_laneLinkIndex[key].push_back(laneLink.to);
+    }
+  }
+  m_statistics.junctions++;
+  m_junctionHashes[record.id] = record.sourceHash;
+}
 
-    std::vector<tsim::Point> points;
-    if (arc != nullptr) {
-      points = calculateArc(x, y, hdg, length, arc->DoubleAttribute("curvature"), offset);
+void OpenDriveParser::buildLaneIndex(tsim::ThreadPool* pool) {
+  auto start = std::chrono::steady_clock::now();
+  m_mapBuilder.setLaneIndex(
+    std::make_shared<tsim::LaneIndex>(m_mapBuilder.map(), tsim::LaneIndexOptions{}, pool));
+  m_statistics.laneIndexMs = msSince(start);
+}
 
-    } else {
-      points = calculateStraight(x, y, hdg, length, offset);
+void OpenDriveParser::buildFrenetTable(tsim::ThreadPool* pool) {
+  auto start = std::chrono::steady_clock::now();
+  m_mapBuilder.setFrenetTable(std::make_shared<tsim::FrenetTable>(m_mapBuilder.map(), pool));
+  m_statistics.frenetMs = msSince(start);
+}
+
+void OpenDriveParser::indexLaneLinks(const tsim::Junction& junction) {
+  for (const auto& connection : junction.connections()) {
+    for (const auto& laneLink : connection.getLaneLinks()) {
+      LaneLinkKey key{static_cast<int32_t>(junction.id()), connection.incomingRoad(),
+                      connection.connectingRoad(), laneLink.from};
+      m_laneLinkIndex[key].push_back(laneLink.to);
     }
-    m_mapBuilder.lane_addLanePoints(lane, points);
   }
 }
 
-std::vector<tsim::Point> OpenDriveParser::calculateStraight(double x, double y, double hdg,
-                                                            double length, double offset) {
-  std::vector<tsim::Point> points;
+void OpenDriveParser::stitchTiles() {
+  // a road end is open if it has no link or links to a road that is not in the map
+  auto isOpen = [this](const std::optional<RoadLinkRecord>& link) {
+    return !link ||
+           (link->elementType == ElementType::eROAD && !m_mapBuilder.getRoad(link->elementId));
+  };
+  auto cellOf = [](const tsim::Point& position) {
+    return std::make_pair(static_cast<int64_t>(std::floor(position.x / SEAM_DISTANCE)),
+                          static_cast<int64_t>(std::floor(position.y / SEAM_DISTANCE)));
+  };
 
-  tsim::Point pOffset(-offset * std::sin(hdg), offset * std::cos(hdg), 0);  // TODO
-  double xOffset = -offset * std::sin(hdg);
-  double yOffset = offset * std::cos(hdg);
+  // open road starts hashed by position, every open end looks up the starts around it
+  std::vector<tsim::Pose> starts(m_roads.size());
+  std::unordered_map<uint64_t, std::vector<std::size_t>> startGrid;
+  for (std::size_t i = 0; i < m_roads.size(); i++) {
+    if (!isOpen(m_roads[i].predecessor)) continue;
+    starts[i] = m_mapBuilder.getRoad(m_roads[i].id)->evaluate(0);
+    auto cell = cellOf(starts[i].position);
+    startGrid[seamCell(cell.first, cell.second)].push_back(i);
+  }
 
-  points.emplace_back(glm::vec3{x + xOffset, y + yOffset, 0.0f});
-  auto end =
-    glm::vec3{x + length * std::cos(hdg) + xOffset, y + length * std::sin(hdg) + yOffset, 0.0f};
+  for (std::size_t i = 0; i < m_roads.size(); i++) {
+    auto& record = m_roads[i];
+    if (!isOpen(record.successor)) continue;
+    const auto* road = m_mapBuilder.getRoad(record.id);
+    auto end = road->evaluate(road->length());
+    auto cell = cellOf(end.position);
+    RoadRecord* next{nullptr};
+    double nextDistance{SEAM_DISTANCE};
+    for (int64_t dx = -1; dx <= 1; dx++) {
+      for (int64_t dy = -1; dy <= 1; dy++) {
+        auto candidates = startGrid.find(seamCell(cell.first + dx, cell.second + dy));
+        if (candidates == startGrid.end()) continue;
+        for (std::size_t j : candidates->second) {
+          // roads within a tile are linked by the tile itself
+          if (m_roadTiles[j] == m_roadTiles[i] || !isOpen(m_roads[j].predecessor)) continue;
+          double distance = glm::distance(end.position, starts[j].position);
+          double heading = std::remainder(end.heading - starts[j].heading, 2 * M_PI);
+          if (distance < nextDistance && std::abs(heading) < SEAM_HEADING) {
+            next = &m_roads[j];
+            nextDistance = distance;
+          }
+        }
+      }
+    }
+    if (!next) continue;
+    record.successor = RoadLinkRecord{ElementType::eROAD, next->id};
+    next->predecessor = RoadLinkRecord{ElementType::eROAD, record.id};
+    stitchLanes(&record, next);
+    m_statistics.seams++;
+  }
+}
 
-  double roadLength{0};
-  double step = 1.f;
-  while (roadLength < length) {
-    glm::vec3 next =
-      glm::vec3{(x += step * std::cos(hdg)) + xOffset, (y += step * std::sin(hdg)) + yOffset, 0.0f};
-    roadLength += step;
-    points.emplace_back(next);
+void OpenDriveParser::stitchLanes(RoadRecord* from, RoadRecord* to) {
+  // last section of from continues in the first section of to
+  const auto* fromRoad = m_mapBuilder.getRoad(from->id);
+  const auto& fromSection = fromRoad->sections().back();
+  const auto& toSection = m_mapBuilder.getRoad(to->id)->sections().front();
+  auto& toLanes = to->sections.front().lanes;
+  for (auto& fromLane : from->sections.back().lanes) {
+    if (fromLane.id == 0) continue;
+    auto end = fromSection.lane(fromLane.id).evaluate(fromRoad->length());
+    LaneRecord* next{nullptr};
+    double nextDistance{SEAM_LANE_DISTANCE};
+    for (auto& toLane : toLanes) {
+      if (toLane.id == 0 || (toLane.id > 0) != (fromLane.id > 0)) continue;
+      auto start = toSection.lane(toLane.id).evaluate(0);
+      double distance = glm::distance(end.position, start.position);
+      if (distance < nextDistance) {
+        next = &toLane;
+        nextDistance = distance;
+      }
+    }
+    if (!next) continue;
+    fromLane.hasLink = true;
+    fromLane.successor = next->id;
+    next->hasLink = true;
+    next->predecessor = fromLane.id;
   }
-  points.emplace_back(end);
-  return points;
 }
 
-std::vector<tsim::Point> OpenDriveParser::calculateArc(double x, double y, double hdg,
-                                                       double length, double arc, double offset) {
-  std::vector<tsim::Point> points;
-  double xOffset = -offset * std::sin(hdg);
-  double yOffset = offset * std::cos(hdg);
-  points.emplace_back(glm::vec3{x + xOffset, y + yOffset, 0.0f});
+void OpenDriveParser::linkRoads(tsim::ThreadPool* pool) {
+  // linear fixup over the pending records, all lookups go through the builder's id index
+  auto linkStart = std::chrono::steady_clock::now();
+  linkPasses(pool);
+  m_roads.clear();
+  m_roadTiles.clear();
+  m_laneLinkIndex.clear();
+  m_statistics.linkMs += msSince(linkStart);
+}
+
+void OpenDriveParser::linkPasses(tsim::ThreadPool* pool) {
+  roadConnections(pool);
+  m_mapBuilder.flushLinks();
+  laneSectionConnections(pool);
+  m_mapBuilder.flushLinks();
+  laneConnections(pool);
+  m_mapBuilder.flushLinks();
+}
+
+void OpenDriveParser::roadConnections(tsim::ThreadPool* pool) {
+  // populate road successors/predecessors
+  pool->parallelFor(m_roads.size(), [this](std::size_t i) {
+    const auto& record = m_roads[i];
+    const auto* road = m_mapBuilder.getRoad(record.id);
+
+    if (record.predecessor) {
+      if (record.predecessor->elementType == ElementType::eROAD) {
+        const auto* predecessor = m_mapBuilder.getRoad(record.predecessor->elementId);
+        if (predecessor) {
+          m_mapBuilder.road_addPredecessor(road->handle(), predecessor->handle());
+        }
+      } else {  // predecessor is a junction
+        const auto* junction = m_mapBuilder.getJunction(record.predecessor->elementId);
+        if (junction) {
+          auto roads = m_mapBuilder.junction_findConnectingRoads(*junction, *road);
+          for (auto predecessor : roads) {
+            m_mapBuilder.road_addPredecessor(road->handle(), predecessor);
+          }
+        }
+      }
+    }
+    if (record.successor) {
+      if (record.successor->elementType == ElementType::eROAD) {
+        const auto* successor = m_mapBuilder.getRoad(record.successor->elementId);
+        if (successor) {
+          m_mapBuilder.road_addSuccessor(road->handle(), successor->handle());
+        }
+      } else {  // successor is a junction
+        const auto* junction = m_mapBuilder.getJunction(record.successor->elementId);
+        if (junction) {
+          auto roads = m_mapBuilder.junction_findConnectingRoads(*junction, *road);
+          for (auto successor : roads) {
+            m_mapBuilder.road_addSuccessor(road->handle(), successor);
+          }
+        }
+      }
+    }
+  });
+}
+
+std::vector<tsim::Point> OpenDriveParser::calculateRoadPoints(const RoadRecord& record) const {
+  auto referenceLine = sampleReferenceLine(record.planView, 0, std::numeric_limits<double>::max(),
+                                           /*max_offset=*/0, m_options.tolerance);
+  applyRoadProfiles(record.elevations, {}, &referenceLine);
+  return calculateOffsetPoints(referenceLine, 0.0);
+}
 
-  auto xM = x + 1 / arc * -std::sin(hdg);
-  auto yM = y + 1 / arc * std::cos(hdg);
-  double road_length{0};
-  double step = 0.3f;
-  double start_angle = hdg - tsim::util::sgn(arc) * M_PI / 2;
-  double end_angle = start_angle + length * arc;
+void OpenDriveParser::laneSectionConnections(tsim::ThreadPool* pool) {
+  // road links are complete, every job reads the sections of neighbouring roads
+  pool->parallelFor(m_roads.size(), [this](std::size_t i) {
+    const auto& record = m_roads[i];
+    const auto* road = m_mapBuilder.getRoad(record.id);
+    auto laneSections = road->sections();
+    for (std::size_t laneSectionCounter = 0; laneSectionCounter < laneSections.size();
+         laneSectionCounter++) {
+      // populate lane section connections
+      auto laneSection = laneSections.at(laneSectionCounter).handle();
+      if (record.junction == -1) {  // TODO not according to standard
+        // road is not part of a junction. For first lane section, add last lane section of previous
+        // road as precedessor. For last lane section, add first lane section of next road as
+        // successor. Otherwise add prev/next lane section in road as successor.
+        if (laneSections.size() == 1) {
+          for (const auto& succ : road->predecessors())
+            m_mapBuilder.laneSection_addPredecessor(laneSection, succ.sections().back().handle());
+          for (const auto& succ : road->successors())
+            m_mapBuilder.laneSection_addSuccessor(laneSection, succ.sections().front().handle());
+        } else if (laneSectionCounter == 0) {
+          m_mapBuilder.laneSection_addSuccessor(laneSection,
+                                                laneSections.at(laneSectionCounter + 1).handle());
+          for (const auto& succ : road->predecessors())
+            m_mapBuilder.laneSection_addPredecessor(laneSection, succ.sections().back().handle());
+        } else if (laneSectionCounter == laneSections.size() - 1) {
+          m_mapBuilder.laneSection_addPredecessor(laneSection,
+                                                  laneSections.at(laneSectionCounter - 1).handle());
+          for (const auto& succ : road->successors())
+            m_mapBuilder.laneSection_addSuccessor(laneSection, succ.sections().front().handle());
+        } else {
+          m_mapBuilder.laneSection_addSuccessor(laneSection,
+                                                laneSections.at(laneSectionCounter + 1).handle());
+          m_mapBuilder.laneSection_addPredecessor(laneSection,
+                                                  laneSections.at(laneSectionCounter - 1).handle());
+        }
+      } else {
+        // road is part of a junction. Add last lane section of previous road as predecessor, first
+        // lane section of subsequent road as successor
+        for (const auto& succ : road->predecessors())
+          m_mapBuilder.laneSection_addPredecessor(laneSection, succ.sections().back().handle());
+        for (const auto& succ : road->successors())
+          m_mapBuilder.laneSection_addSuccessor(laneSection, succ.sections().front().handle());
+      }
+    }
+  });
+}
 
-  tsim::Point end((xM + (1 / std::abs(arc) + tsim::util::sgn(arc) * -offset) * std::cos(end_angle)),
-                  (yM + (1 / std::abs(arc) + tsim::util::sgn(arc) * -offset) * std::sin(end_angle)),
-                  0.0f);
+void OpenDriveParser::laneConnections(tsim::ThreadPool* pool) {
+  // populate lane successors/predecessors
+  pool->parallelFor(m_roads.size(), [this](std::size_t i) {
+    const auto& record = m_roads[i];
+    auto laneSections = m_mapBuilder.getRoad(record.id)->sections();
+    for (std::size_t laneSectionCounter = 0; laneSectionCounter < laneSections.size();
+         laneSectionCounter++) {
+      laneConnections(laneSections.at(laneSectionCounter),
+                      record.sections.at(laneSectionCounter));
+    }
+  });
+}
 
-  for (double angle = start_angle; tsim::util::sgn(arc) * angle < tsim::util::sgn(arc) * end_angle;
-       angle += length * arc / 20) {
-    glm::vec3 next = glm::vec3{
-      (xM + (1 / std::abs(arc) + tsim::util::sgn(arc) * -offset) * std::cos(angle)),
-      (yM + (1 / std::abs(arc) + tsim::util::sgn(arc) * -offset) * std::sin(angle)), 0.0f};
-    points.emplace_back(next);
+void OpenDriveParser::laneConnections(const tsim::LaneSection& lane_section,
+                                      const LaneSectionRecord& record) {
+  auto predecessors = lane_section.predecessors();
+  auto successors = lane_section.successors();
+  for (const auto& laneRecord : record.lanes) {
+    if (laneRecord.type != tsim::LaneType::eDRIVING) continue;  // TODO only driving Lanes
+    auto lane = lane_section.lane(laneRecord.id).handle();
+    // a link of the lane names the lane in the neighbouring section. Without one the neighbour may
+    // be a connecting road of a junction, whose lane links apply. Links to lanes the neighbour does
+    // not have are skipped.
+    for (const auto& elem : predecessors) {
+      if (laneRecord.predecessor) {
+        if (const auto* to = elem.findLane(*laneRecord.predecessor)) {
+          m_mapBuilder.lane_addPredecessor(lane, to->handle());
+        }
+        continue;
+      }
+      for (int id : junctionLaneLinks(lane_section, elem, laneRecord.id)) {
+        if (const auto* to = elem.findLane(id)) {
+          m_mapBuilder.lane_addPredecessor(lane, to->handle());
+        }
+      }
+    }
+    for (const auto& elem : successors) {
+      if (laneRecord.successor) {
+        if (const auto* to = elem.findLane(*laneRecord.successor)) {
+          m_mapBuilder.lane_addSuccessor(lane, to->handle());
+        }
+        continue;
+      }
+      for (int id : junctionLaneLinks(lane_section, elem, laneRecord.id)) {
+        if (const auto* to = elem.findLane(id)) {
+          m_mapBuilder.lane_addSuccessor(lane, to->handle());
+        }
+      }
+    }
   }
-  points.emplace_back(end);
+}
+
+tsim::Span<const int> OpenDriveParser::junctionLaneLinks(const tsim::LaneSection& lane_section,
+                                                         const tsim::LaneSection& neighbour,
+                                                         int lane_id) const {
+  LaneLinkKey key{neighbour.road().junction(), lane_section.road().id(), neighbour.road().id(),
+                  lane_id};
+  auto links = m_laneLinkIndex.find(key);
+  if (links == m_laneLinkIndex.end()) return {};
+  return links->second;
+}
 
-  return points;
+std::size_t OpenDriveParser::LaneLinkKeyHash::operator()(const LaneLinkKey& key) const {
+  return tsim::util::hash64(&key, sizeof(key));
 }
 
-tsim::LaneType OpenDriveParser::parseLaneType(const char* lt) {
-  if (strcmp(lt, "sidewalk") == 0) return tsim::LaneType::eSIDEWALK;
-  if (strcmp(lt, "shoulder") == 0) return tsim::LaneType::eSHOULDER;
-  if (strcmp(lt, "driving") == 0) return tsim::LaneType::eDRIVING;
-  if (strcmp(lt, "restricted") == 0) return tsim::LaneType::eRESTRICTED;
-  if (strcmp(lt, "median") == 0) return tsim::LaneType::eMEDIAN;
-  if (strcmp(lt, "parking") == 0) return tsim::LaneType::ePARKING;
-  if (strcmp(lt, "none") == 0) return tsim::LaneType::eNONE;
+tsim::LaneType OpenDriveParser::parseLaneType(std::string_view lt) const {
+  if (lt == "sidewalk") return tsim::LaneType::eSIDEWALK;
+  if (lt == "shoulder") return tsim::LaneType::eSHOULDER;
+  if (lt == "driving") return tsim::LaneType::eDRIVING;
+  if (lt == "restricted") return tsim::LaneType::eRESTRICTED;
+  if (lt == "median") return tsim::LaneType::eMEDIAN;
+  if (lt == "parking") return tsim::LaneType::ePARKING;
+  if (lt == "none") return tsim::LaneType::eNONE;
   throw std::logic_error("unknown lane type " + std::string(lt));
 }
 }  // namespace parser
\ No newline at end of file
@@ -1,48 +1,244 @@
 #ifndef __OPENDRIVE_PARSER_HPP__
 #define __OPENDRIVE_PARSER_HPP__
 
-#include <tinyxml2.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "opendrive_records.hpp"
 #include "tsim_map_builder.hpp"
+#include "tsim_mapped_file.hpp"
+#include "tsim_thread_pool.hpp"
+#include "tsim_util.hpp"
+#include "xml_scanner.hpp"
 
 namespace parser {
 
+struct LoadStatistics {
+  std::size_t roads{0};
+  std::size_t junctions{0};
+  std::size_t laneSections{0};
+  std::size_t lanes{0};
+  std::size_t points{0};         // road and lane boundary points calculated during loading
+  std::size_t clippedPoints{0};  // boundary points saved by clipping to the lane section
+  std::size_t fileBytes{0};
+  bool fromCache{false};
+  double tolerance{0};
+
+  std::size_t threads{0};
+  std::size_t maxInFlight{0};  // most roads read but not yet added to the map at the same time
+  std::size_t chunks{0};       // parallel read: number of chunks
+  std::size_t tiles{0};        // tiled map: number of files
+  std::size_t seams{0};        // tiled map: roads linked to a road of a neighbouring tile
+
+  // Reading, tessellation and merging overlap (see ParserOptions::inFlightRoads), the stage times
+  // show which one limits loading. A stall means reading waited for tessellation.
+  // map file, scan, build roads, without stalls and merging. Parallel read: scan only, summed over
+  // all threads, roads are built while merging.
+  double readMs{0};
+  double tessellateMs{0};  // road and lane points, summed over all threads
+  double mergeMs{0};       // tessellated roads added to the map in document order
+  double stallMs{0};       // reading blocked by a full in-flight window
+  double pipelineMs{0};    // read, tessellate and merge
+  double linkMs{0};        // road, lane section and lane link fixup
+  double laneIndexMs{0};   // see ParserOptions::laneIndex
+  double frenetMs{0};      // see ParserOptions::frenetTable
+  double totalMs{0};
+
+  // reload: roads read and tessellated again, unchanged roads whose links were rebuilt and roads
+  // no longer in the file. The map is locked for swapMs.
+  std::size_t changedRoads{0};
+  std::size_t relinkedRoads{0};
+  std::size_t removedRoads{0};
+  double swapMs{0};
+};
+
+struct ParserOptions {
+  std::size_t threads{0};  // tessellation threads, 0: one per hardware core
+  // roads that are read but not yet added to the map. Roads are tessellated by worker threads while
+  // the file is still read, memory for records and points in flight stays bounded by this window
+  // instead of the file size. 0: eight per thread.
+  std::size_t inFlightRoads{0};
+  // the file is split at top level <road> and <junction> elements into chunks that are read and
+  // tessellated concurrently, for large files where a single reader is the bottleneck. Records and
+  // points of the whole file are held until they are merged, inFlightRoads does not apply.
+  bool parallelRead{false};
+  bool mapCache{false};    // load from / compile to <filename>.tsimmap, see tsim::MapCache
+  // maximum chord error [m] between tessellated points and the exact geometry. Straights are
+  // represented by their end points, arcs get as many points as the tolerance requires.
+  // 0: fixed sampling (1 m steps on straights, 20 steps per arc).
+  double tolerance{0};
+  // lane boundaries are calculated on first access instead of during loading (see
+  // tsim::GeometryCache). maxResidentPoints limits the number of calculated points kept in memory,
+  // 0: no limit.
+  bool lazyGeometry{false};
+  std::size_t maxResidentPoints{0};
+  // builds a tsim::LaneIndex over all lanes once the map is loaded (tsim::Map::laneIndex()), lazy
+  // lane boundaries are calculated for it. reload builds it again.
+  bool laneIndex{false};
+  // builds the arc length tables of all lanes once the map is loaded (tsim::Map::frenetTable()),
+  // vehicles then move their step along the lane center. reload adds the tables of new lanes.
+  bool frenetTable{false};
+};
+
+// One file of a tiled map. Tiles are usually produced separately and reuse ids and coordinates:
+// all road and junction ids of the tile are shifted by idOffset, all points by the origin of the
+// tile in the map (x, y, z).
+struct MapTile {
+  std::string filename;
+  uint32_t idOffset{0};
+  double x{0};
+  double y{0};
+  double z{0};
+};
+
 class OpenDriveParser {
 public:
+  explicit OpenDriveParser(ParserOptions options = {})
+      : m_options(options){};
+
   std::shared_ptr<tsim::Map> parse(const std::string& filename);
+  // all tiles in one map. The chunks of all files are read and tessellated concurrently (see
+  // ParserOptions::parallelRead), loading takes about as long as the largest tile. A road end
+  // without a link is connected to the road that continues it in another tile, lanes are matched
+  // by their positions on the seam. The map cache is not used.
+  std::shared_ptr<tsim::Map> parse(const std::vector<MapTile>& tiles);
+  // Incremental reload of map from its edited file, the map has to be loaded by this parser from a
+  // single file (std::invalid_argument otherwise). Roads and junctions are compared by id and the hash
+  // of their element text: changed roads are read and tessellated again, they and the roads linked
+  // to them are relinked. The changes are swapped into the map while step_mutex is held
+  // exclusively, simulation steps that hold it shared are only paused for the swap. Vehicles on a
+  // replaced road keep its old objects until they leave it.
+  void reload(const std::string& filename, const std::shared_ptr<tsim::Map>& map,
+              std::shared_mutex* step_mutex = nullptr);
+  const LoadStatistics& statistics() const {
+    return m_statistics;
+  }
 
 private:
-  void parseHeader();
-  void parseRoads();
-  void parseJunctions();
-  void roadConnections();
-  void parseLaneSections();
-  void parseLanes();
-  void laneConnections();
-
-  void parseLane(tsim::Lane* lane, const tinyxml2::XMLElement* odrLane);
-  void parseLaneGroup(std::shared_ptr<tsim::LaneSection> lane_section,
-                      const tinyxml2::XMLElement* group);
-  void laneConnections(std::shared_ptr<tsim::LaneSection> lane_section,
-                       const tinyxml2::XMLElement* group);
-
-  // calculate geometrics
-  void calculateRoadPoints(tsim::Road* road, const tinyxml2::XMLElement* odr_road);
-  void calculateLanePoints(tsim::Lane* lane, const tinyxml2::XMLElement* odrLane);
-  void calculateLaneBoundaryPoints(tsim::Lane* lane, const tinyxml2::XMLElement* odrLane);
-
-  std::vector<tsim::Point> calculateStraight(double x, double y, double hdg, double length,
-                                             double offset = 0);
-  std::vector<tsim::Point> calculateArc(double x, double y, double hdg, double length, double arc,
-                                        double offset = 0);
+  std::shared_ptr<tsim::Map> parseFile(const std::string& filename);
+  // hashes of the road and junction elements of filename for reload, no records are read. A map
+  // from the cache has no records the hashes could be taken from.
+  void hashElements(const std::string& filename);
+
+  // throws for OpenDRIVE revisions other than 1.x
+  void parseHeader(const XmlTag& odrHeader) const;
+  // read elements from the scanner, the scanner is left behind the element's end tag
+  // records do not depend on parser state, elements can be read concurrently
+  JunctionRecord readJunction(XmlScanner* scanner, const XmlTag& odrJunction) const;
+  RoadRecord readRoad(XmlScanner* scanner, const XmlTag& odrRoad) const;
+  GeometryRecord readGeometry(XmlScanner* scanner, const XmlTag& geom) const;
+  LaneSectionRecord readLaneSection(XmlScanner* scanner, const XmlTag& odrLaneSection) const;
+  void readLaneGroup(XmlScanner* scanner, const XmlTag& group,
+                     std::vector<LaneRecord>* lanes) const;
+  void buildRoad(const RoadRecord& record);
+  void buildJunction(const JunctionRecord& record);
+  // lane index of the map of the builder, see ParserOptions::laneIndex
+  void buildLaneIndex(tsim::ThreadPool* pool);
+  // arc length tables of the map of the builder, see ParserOptions::frenetTable
+  void buildFrenetTable(tsim::ThreadPool* pool);
+  // junction lane links of a junction of the map (see m_laneLinkIndex)
+  void indexLaneLinks(const tsim::Junction& junction);
+
+  // pipeline: roads are tessellated in the order they are read and added to the map in the same
+  // order, so the map does not depend on the number of threads
+  struct PendingRoad {
+    RoadRecord* record{nullptr};
+    TessellatedRoad result;
+    double tessellateMs{0};
+    std::future<void> done;
+  };
+  void submitRoad(tsim::ThreadPool* pool, RoadRecord* record);
+  // waits for the oldest pending road and adds its points to the map
+  void mergeRoad();
+  void addTessellation(RoadRecord* record, TessellatedRoad* result);
+
+  // parallel read: top level elements between begin and end of the document, read and tessellated
+  // by one job. Elements of a tile are moved into the map frame before tessellation.
+  struct ParsedChunk {
+    std::string_view document;
+    const MapTile* tile{nullptr};
+    std::size_t begin{0};
+    std::size_t end{0};
+    std::vector<RoadRecord> roads;
+    std::vector<TessellatedRoad> results;  // same order as roads
+    std::vector<JunctionRecord> junctions;
+    double readMs{0};
+    double tessellateMs{0};
+  };
+  void readElements(XmlScanner* scanner, const XmlTag& odr, tsim::ThreadPool* pool,
+                    tsim::MappedFile* file);
+  // splits the body of the document (behind the <OpenDRIVE> start tag) into chunks
+  void splitDocument(std::string_view document, std::size_t body_begin,
+                     std::vector<ParsedChunk>* chunks);
+  void readChunks(std::vector<ParsedChunk>* chunks, tsim::ThreadPool* pool);
+  void parseChunk(ParsedChunk* chunk) const;
+
+  // tiled map: links open road ends to the start of a road in another tile at the same position
+  // and heading, before link fixup
+  void stitchTiles();
+  void stitchLanes(RoadRecord* from, RoadRecord* to);
+
+  // link fixup, runs once all roads and junctions are known. Every job only adds links to the
+  // elements of its own road, roads are processed in parallel.
+  void linkRoads(tsim::ThreadPool* pool);
+  // the passes read the links of the previous pass, their links are flushed in between (see
+  // tsim::MapBuilder::flushLinks)
+  void linkPasses(tsim::ThreadPool* pool);
+  void roadConnections(tsim::ThreadPool* pool);
+  void laneSectionConnections(tsim::ThreadPool* pool);
+  void laneConnections(tsim::ThreadPool* pool);
+  void laneConnections(const tsim::LaneSection& lane_section, const LaneSectionRecord& record);
+  // lanes of neighbour that a junction links to lane_id of lane_section (OpenDRIVE laneLink), empty
+  // if the road of neighbour is no connecting road of a junction for this road
+  tsim::Span<const int> junctionLaneLinks(const tsim::LaneSection& lane_section,
+                                          const tsim::LaneSection& neighbour, int lane_id) const;
+
+  // calculate geometrics. Only depend on the record, safe to call from several threads.
+  TessellatedRoad tessellateRoad(const RoadRecord& record) const;
+  std::vector<tsim::Point> calculateRoadPoints(const RoadRecord& record) const;
 
   // specific enum parsers
-  tsim::LaneType parseLaneType(const char* lt);
+  tsim::LaneType parseLaneType(std::string_view lt) const;
 
 private:
-  tinyxml2::XMLDocument m_xmlDoc;
+  ParserOptions m_options;
   tsim::MapBuilder m_mapBuilder;
+  // pending link information, cleared after fixup. Elements keep their address while roads are
+  // added, tessellation reads them concurrently.
+  std::deque<RoadRecord> m_roads;
+  std::deque<PendingRoad> m_pending;
+  std::vector<const MapTile*> m_roadTiles;  // tiled map: tile of every road in m_roads
+
+  // junction lane links by (junction, incoming road, connecting road, from lane), filled when
+  // junctions are built, lookups during link fixup
+  struct LaneLinkKey {
+    int32_t junction{0};
+    uint32_t incomingRoad{0};
+    uint32_t connectingRoad{0};
+    int32_t fromLane{0};
+
+    bool operator==(const LaneLinkKey& other) const {
+      return junction == other.junction && incomingRoad == other.incomingRoad &&
+             connectingRoad == other.connectingRoad && fromLane == other.fromLane;
+    }
+  };
+  struct LaneLinkKeyHash {
+    std::size_t operator()(const LaneLinkKey& key) const;
+  };
+  std::unordered_map<LaneLinkKey, std::vector<int>, LaneLinkKeyHash> m_laneLinkIndex;
+  // hashes of the element text of the loaded roads and junctions by id, see reload
+  std::unordered_map<uint32_t, uint64_t> m_roadHashes;
+  std::unordered_map<uint32_t, uint64_t> m_junctionHashes;
+  LoadStatistics m_statistics;
 };
 }  // namespace parser
 
-#endif  // __OPENDRIVE_PARSER_HPP__
\ No newline at end of file
+#endif  // __OPENDRIVE_PARSER_HPP__
@@ -0,0 +1,151 @@
+#ifndef __OPENDRIVE_RECORDS_HPP__
+#define __OPENDRIVE_RECORDS_HPP__
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "tsim_geometry_cache.hpp"
+#include "tsim_map.hpp"
+
+namespace parser {
+
+// Plain data read from a single pass over the OpenDRIVE document. Records keep everything that is
+// needed after the element has been visited (geometry, link ids) so that link resolution can run
+// as a separate linear fixup stage once all roads and junctions are known.
+
+enum class GeometryType { eLINE, eARC, eSPIRAL, ePARAM_POLY3 };
+
+struct GeometryRecord {
+  GeometryType type{GeometryType::eLINE};
+  double s{0};
+  double x{0};
+  double y{0};
+  double hdg{0};
+  double length{0};
+  double curvature{0};     // arc, spiral: curvStart
+  double curvatureEnd{0};  // spiral: curvEnd
+  std::array<double, 4> u{};  // paramPoly3: aU, bU, cU, dU
+  std::array<double, 4> v{};  // paramPoly3: aV, bV, cV, dV
+  double pRange{1};           // paramPoly3: 1 if normalized, length if arcLength
+};
+
+enum class ElementType { eROAD, eJUNCTION };
+
+struct RoadLinkRecord {
+  ElementType elementType{ElementType::eROAD};
+  uint32_t elementId{0};
+};
+
+struct LaneRecord {
+  int id{0};
+  tsim::LaneType type{tsim::LaneType::eNONE};
+  double sOffset{0};                         // of the first width record
+  std::vector<tsim::CubicPolynomial> widths;  // sOffset relative to the lane section
+  bool hasLink{false};
+  std::optional<int> predecessor;
+  std::optional<int> successor;
+};
+
+struct LaneSectionRecord {
+  double s{0};
+  std::vector<LaneRecord> lanes;  // left group first, then right group
+};
+
+struct RoadRecord {
+  uint32_t id{0};
+  int junction{-1};
+  std::optional<RoadLinkRecord> predecessor;
+  std::optional<RoadLinkRecord> successor;
+  std::vector<GeometryRecord> planView;
+  std::vector<tsim::CubicPolynomial> laneOffsets;
+  std::vector<tsim::CubicPolynomial> elevations;       // z of the reference line
+  std::vector<tsim::CubicPolynomial> superelevations;  // roll angle around the reference line
+  std::vector<LaneSectionRecord> sections;
+  uint64_t sourceHash{0};  // of the element text, identifies edited roads on reload
+};
+
+struct ConnectionRecord {
+  uint32_t incomingRoad{0};
+  uint32_t connectingRoad{0};
+  std::vector<tsim::LaneLink> laneLinks;
+};
+
+struct JunctionRecord {
+  uint32_t id{0};
+  std::vector<ConnectionRecord> connections;
+  uint64_t sourceHash{0};
+};
+
+// Samples of a road's reference line with their s and left unit normal. Kept as separate arrays so
+// that lane points (sample + offset * normal) are calculated for all samples in one vectorizable
+// loop. Samples are added flat (z and nz 0), elevation and superelevation are applied afterwards
+// for all samples at once.
+struct ReferenceLine {
+  std::vector<double> s;
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+  std::vector<double> nx;
+  std::vector<double> ny;
+  std::vector<double> nz;
+
+  void add(double ps, double px, double py, double pnx, double pny) {
+    s.push_back(ps);
+    x.push_back(px);
+    y.push_back(py);
+    z.push_back(0);
+    nx.push_back(pnx);
+    ny.push_back(pny);
+    nz.push_back(0);
+  }
+  void resize(std::size_t size) {
+    s.resize(size);
+    x.resize(size);
+    y.resize(size);
+    z.resize(size);
+    nx.resize(size);
+    ny.resize(size);
+    nz.resize(size);
+  }
+  void reserve(std::size_t size) {
+    s.reserve(size);
+    x.reserve(size);
+    y.reserve(size);
+    z.reserve(size);
+    nx.reserve(size);
+    ny.reserve(size);
+    nz.reserve(size);
+  }
+  std::size_t size() const {
+    return x.size();
+  }
+};
+
+struct LaneBoundaries {
+  uint32_t inner{0};
+  uint32_t outer{0};
+};
+
+// Lane boundaries of one lane section. Index 0 is the reference line, the outer boundary of a lane
+// is the inner boundary of the next lane on the same side.
+struct TessellatedSection {
+  std::vector<std::vector<tsim::Point>> boundaries;
+  std::vector<LaneBoundaries> laneBoundaries;  // same order as the lanes in the record
+  std::shared_ptr<const tsim::BoundaryGenerator> geometry;  // instead of boundaries, lazy loading
+};
+
+// Result of tessellating one road record, sections in the same order as in the record.
+struct TessellatedRoad {
+  std::vector<tsim::Point> roadPoints;
+  std::vector<TessellatedSection> sections;
+  // lane boundary points that were not generated because boundaries are clipped to their lane
+  // section, compared to tessellating every boundary along the full reference line
+  std::size_t clippedPoints{0};
+};
+
+}  // namespace parser
+
+#endif  // __OPENDRIVE_RECORDS_HPP__
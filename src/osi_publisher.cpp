@@ -17,14 +17,19 @@ void OsiPublisher::start() {
 }
 
 void OsiPublisher::publish() {
+  // cleared messages keep their moving objects allocated for the next round
+  osi3::SensorView sensorView;
   while (eCAL::Ok()) {
-    osi3::SensorView sensorView;
+    sensorView.Clear();
 
-    for (auto object : m_simulator->getObjects()) {
+    for (const auto& object : m_simulator->getObjects()) {
       auto* osiObject = sensorView.mutable_global_ground_truth()->add_moving_object();
       osiObject->mutable_base()->mutable_position()->set_x(object->getPosition().x);
       osiObject->mutable_base()->mutable_position()->set_y(object->getPosition().y);
       osiObject->mutable_base()->mutable_position()->set_z(object->getPosition().z);
+      osiObject->mutable_base()->mutable_orientation()->set_roll(object->getOrientation().x);
+      osiObject->mutable_base()->mutable_orientation()->set_pitch(object->getOrientation().y);
+      osiObject->mutable_base()->mutable_orientation()->set_yaw(object->getOrientation().z);
     }
 
     m_publisher->Send(sensorView);
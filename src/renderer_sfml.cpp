@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <iostream>
+#include <shared_mutex>
 #include <thread>
 //
 #include "tsim_map.hpp"
@@ -29,7 +30,7 @@ Renderer::Renderer(tsim::Simulator* sim)
 
 void Renderer::findMaxMinValues() {
   for (const auto& road : m_map->roads()) {
-    for (const auto& pt : road->points()) {
+    for (const auto& pt : road.points()) {
       if (pt.x > m_maxX) {
         m_maxX = pt.x;
       }
@@ -60,8 +61,6 @@ void Renderer::render() {
     }
     m_window->clear(m_backgroundColor);
 
-    m_objects = m_simulator->getObjects();
-
     drawLanes();
     drawVehicles();
 
@@ -72,21 +71,23 @@ void Renderer::render() {
 }
 
 void Renderer::drawLanes() {
+  std::shared_lock<std::shared_mutex> lock(m_simulator->stepMutex());
+  // lazily loaded and reloaded maps change their boundaries, all lanes are collected every frame
+  // and drawn at once
+  m_laneLines.clear();
   for (const auto& road : m_map->roads()) {
-    for (const auto& section : road->sections()) {
-      for (const auto& lane : section->lanes()) {
-        if (lane->laneType() == tsim::LaneType::eDRIVING) {
-          sf::VertexArray lines(sf::LineStrip, lane->boundaryPoints().size());
-          std::size_t cnt{0};
-          for (const auto& pt : lane->boundaryPoints()) {
-            lines[cnt].position = sf::Vector2f(pt.x, -pt.y);
-            cnt++;
-          }
-          m_window->draw(lines);
+    for (const auto& section : road.sections()) {
+      for (const auto& lane : section.lanes()) {
+        if (lane.laneType() != tsim::LaneType::eDRIVING) continue;
+        auto points = lane.boundaryPoints();
+        for (std::size_t i = 1; i < points.size(); i++) {
+          m_laneLines.append(sf::Vertex(sf::Vector2f(points[i - 1].x, -points[i - 1].y)));
+          m_laneLines.append(sf::Vertex(sf::Vector2f(points[i].x, -points[i].y)));
         }
       }
     }
   }
+  m_window->draw(m_laneLines);
 }
 
 void Renderer::drawVehicles() const {
@@ -95,7 +96,7 @@ void Renderer::drawVehicles() const {
   rectangle.setSize(sf::Vector2f(size, size));
   // rectangle.setFillColor(sf::Color::Red);
   // rectangle.setOutlineThickness(0);
-  for (const auto object : m_objects) {
+  for (const auto& object : m_simulator->getObjects()) {
     rectangle.setPosition(object->getPosition().x - (size / 2),
                           -object->getPosition().y - (size / 2));
     m_window->draw(rectangle);
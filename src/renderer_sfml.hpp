@@ -32,7 +32,8 @@ private:
 
   tsim::Simulator* m_simulator;
   std::shared_ptr<tsim::Map> m_map;
-  std::vector<std::shared_ptr<tsim::TrafficObject>> m_objects;
+  // lane boundaries of the frame as line segments, refilled every frame without reallocating
+  sf::VertexArray m_laneLines{sf::Lines};
 
   double m_minX{0};
   double m_maxX{0};
@@ -0,0 +1,262 @@
+#include "tsim_frenet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "tsim_thread_pool.hpp"
+
+namespace tsim {
+
+namespace {
+// the center line deviates at most this far [m] from the chords between samples
+constexpr double CHORD_TOLERANCE{0.005};
+// samples at least every MAX_STEP [m] along the road, intervals are halved at most MAX_DEPTH times
+constexpr double MAX_STEP{10};
+constexpr int MAX_DEPTH{12};
+// transforms of a batch calculated by one job
+constexpr std::size_t BATCH_SIZE{256};
+
+// chord from samples[i] to samples[i + 1] that contains value, and the fraction of the chord up to
+// value. key selects the ascending member (s or roadS), values outside the lane are clamped.
+template <typename Samples, typename Key>
+std::size_t locate(const Samples& samples, double value, Key key, double* fraction) {
+  auto next = std::upper_bound(samples.begin() + 1, samples.end() - 1, value,
+                               [key](double v, const auto& sample) {
+                                 return v < sample.*key;
+                               });
+  auto i = static_cast<std::size_t>(next - samples.begin() - 1);
+  double length = samples[i + 1].*key - samples[i].*key;
+  *fraction = length > 0 ? std::clamp((value - samples[i].*key) / length, 0.0, 1.0) : 0.0;
+  return i;
+}
+
+template <typename Fn> void forBatches(std::size_t count, ThreadPool* pool, Fn fn) {
+  auto batches = (count + BATCH_SIZE - 1) / BATCH_SIZE;
+  auto run = [count, &fn](std::size_t batch) {
+    auto end = std::min(count, (batch + 1) * BATCH_SIZE);
+    for (auto i = batch * BATCH_SIZE; i < end; i++) fn(i);
+  };
+  if (pool && batches > 1) {
+    pool->parallelFor(batches, run);
+  } else {
+    for (std::size_t batch = 0; batch < batches; batch++) run(batch);
+  }
+}
+}  // namespace
+
+FrenetTable::FrenetTable(const Map& map, ThreadPool* pool) {
+  m_laneStart.push_back(0);
+  addLanes(map, 0, pool);
+}
+
+FrenetTable::FrenetTable(const Map& map, const FrenetTable& previous, ThreadPool* pool)
+    : m_laneStart(previous.m_laneStart)
+    , m_samples(previous.m_samples) {
+  if (map.m_lanes.size() < previous.lanes()) {
+    throw std::invalid_argument("map has fewer lanes than the previous frenet table");
+  }
+  if (m_laneStart.empty()) m_laneStart.push_back(0);
+  addLanes(map, lanes(), pool);
+}
+
+void FrenetTable::addLanes(const Map& map, std::size_t first, ThreadPool* pool) {
+  std::vector<std::vector<Sample>> laneSamples(map.m_lanes.size() - first);
+  auto sample = [&map, first, &laneSamples](std::size_t i) {
+    sampleLane(map.m_lanes[first + i], &laneSamples[i]);
+  };
+  if (pool) {
+    pool->parallelFor(laneSamples.size(), sample);
+  } else {
+    for (std::size_t i = 0; i < laneSamples.size(); i++) sample(i);
+  }
+  std::size_t count{m_samples.size()};
+  for (const auto& samples : laneSamples) count += samples.size();
+  if (count > UINT32_MAX) throw std::length_error("too many samples for the frenet table");
+  m_samples.reserve(count);
+  m_laneStart.reserve(map.m_lanes.size() + 1);
+  for (auto& samples : laneSamples) {
+    m_samples.insert(m_samples.end(), samples.begin(), samples.end());
+    m_laneStart.push_back(static_cast<uint32_t>(m_samples.size()));
+    std::vector<Sample>().swap(samples);
+  }
+}
+
+void FrenetTable::sampleLane(const Lane& lane, std::vector<Sample>* samples) {
+  const auto& section = lane.laneSection();
+  const auto& road = section.road();
+  double start = section.sOffset();
+  double end = start + section.length();
+  // every lane has at least two samples, a lane without geometry has length 0 at the origin
+  if (road.segments().empty()) {
+    samples->push_back({0, start, 0, 0, 0});
+    samples->push_back({0, end, 0, 0, 0});
+    return;
+  }
+  // the center line may bend at the start of a road segment, it is sampled there
+  std::vector<double> breaks{start};
+  for (const auto& segment : road.segments()) {
+    if (segment.s > start && segment.s < end) breaks.push_back(segment.s);
+  }
+  breaks.push_back(std::max(start, end));
+
+  samples->push_back(evaluate(lane, start));
+  for (std::size_t i = 0; i + 1 < breaks.size(); i++) {
+    double length = breaks[i + 1] - breaks[i];
+    auto steps = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(length / MAX_STEP)));
+    for (std::size_t k = 1; k <= steps; k++) {
+      auto next = evaluate(lane, breaks[i] + length * k / steps);
+      refine(lane, samples->back(), next, 0, samples);
+      samples->push_back(next);
+    }
+  }
+  // cumulative chord length
+  (*samples)[0].s = 0;
+  for (std::size_t i = 1; i < samples->size(); i++) {
+    auto& sample = (*samples)[i];
+    const auto& previous = (*samples)[i - 1];
+    sample.s = previous.s + std::hypot(sample.x - previous.x, sample.y - previous.y);
+  }
+}
+
+void FrenetTable::refine(const Lane& lane, Sample a, Sample b, int depth,
+                         std::vector<Sample>* samples) {
+  if (depth >= MAX_DEPTH) return;
+  auto middle = evaluate(lane, (a.roadS + b.roadS) / 2);
+  // distance of the center line from the chord at its middle
+  if (std::hypot(middle.x - (a.x + b.x) / 2, middle.y - (a.y + b.y) / 2) <= CHORD_TOLERANCE) {
+    return;
+  }
+  refine(lane, a, middle, depth + 1, samples);
+  samples->push_back(middle);
+  refine(lane, middle, b, depth + 1, samples);
+}
+
+FrenetTable::Sample FrenetTable::evaluate(const Lane& lane, double road_s) {
+  // the lane center as in Lane::evaluate, without the profiles
+  const auto& section = lane.laneSection();
+  double innerRate;
+  double outerRate;
+  double t = (section.boundaryOffset(lane.m_innerBoundary, road_s, &innerRate) +
+              section.boundaryOffset(lane.m_outerBoundary, road_s, &outerRate)) /
+             2;
+  auto pose = section.road().evaluate(road_s, t);
+  // heading of the center line: the reference line heading turned by the lateral drift t' of the
+  // center against the stretch 1 - k t = 1 / (1 + curvature t) of the parallel curve
+  double cosBank = std::cos(pose.bank);
+  double stretch = 1 + pose.curvature * t * cosBank;
+  double heading = pose.heading;
+  if (stretch > 0) heading += std::atan((innerRate + outerRate) / 2 * cosBank * stretch);
+  return {0, road_s, pose.position.x, pose.position.y, heading};
+}
+
+Span<const FrenetTable::Sample> FrenetTable::samples(LaneHandle lane) const {
+  if (!contains(lane)) {
+    throw std::out_of_range("lane " + std::to_string(lane) + " not found in frenet table");
+  }
+  return {m_samples.data() + m_laneStart[lane], m_laneStart[lane + 1] - m_laneStart[lane]};
+}
+
+double FrenetTable::length(LaneHandle lane) const {
+  return samples(lane).back().s;
+}
+
+FrenetPose FrenetTable::pose(LaneHandle lane, double s) const {
+  auto samples = this->samples(lane);
+  double u;
+  auto i = locate(samples, s, &Sample::s, &u);
+  const auto& a = samples[i];
+  const auto& b = samples[i + 1];
+  return {a.x + u * (b.x - a.x), a.y + u * (b.y - a.y),
+          a.heading + u * std::remainder(b.heading - a.heading, 2 * M_PI),
+          a.roadS + u * (b.roadS - a.roadS)};
+}
+
+FrenetPosition FrenetTable::position(LaneHandle lane, const Point& p) const {
+  auto samples = this->samples(lane);
+  // nearest chord
+  double best{std::numeric_limits<double>::max()};
+  std::size_t chord{0};
+  for (std::size_t i = 0; i + 1 < samples.size(); i++) {
+    const auto& a = samples[i];
+    const auto& b = samples[i + 1];
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double length2 = dx * dx + dy * dy;
+    double u = length2 > 0 ? std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / length2, 0.0, 1.0)
+                           : 0.0;
+    double ex = p.x - (a.x + u * dx);
+    double ey = p.y - (a.y + u * dy);
+    if (ex * ex + ey * ey < best) {
+      best = ex * ex + ey * ey;
+      chord = i;
+    }
+  }
+  // The foot point is where p - P(u) is normal to the heading interpolated along the chord, not to
+  // the chord itself: away from the center line the chord normals are off by half the turn of the
+  // chord. The condition is close to linear in u, one secant step. A point behind an end of the
+  // chord belongs to the neighbouring chord.
+  auto along = [&samples, &p](std::size_t i, double u) {
+    const auto& a = samples[i];
+    const auto& b = samples[i + 1];
+    double heading = a.heading + u * std::remainder(b.heading - a.heading, 2 * M_PI);
+    return (p.x - (a.x + u * (b.x - a.x))) * std::cos(heading) +
+           (p.y - (a.y + u * (b.y - a.y))) * std::sin(heading);
+  };
+  double before = along(chord, 0);
+  double behind = along(chord, 1);
+  if (before < 0 && chord > 0) {
+    chord--;
+    behind = before;
+    before = along(chord, 0);
+  } else if (behind > 0 && chord + 2 < samples.size()) {
+    chord++;
+    before = behind;
+    behind = along(chord, 1);
+  }
+  double u = before > behind ? std::clamp(before / (before - behind), 0.0, 1.0)
+                             : (before < 0 ? 0.0 : 1.0);
+  const auto& a = samples[chord];
+  const auto& b = samples[chord + 1];
+  double ex = p.x - (a.x + u * (b.x - a.x));
+  double ey = p.y - (a.y + u * (b.y - a.y));
+  double heading = a.heading + u * std::remainder(b.heading - a.heading, 2 * M_PI);
+  double t = std::hypot(ex, ey);
+  return {a.s + u * (b.s - a.s), std::cos(heading) * ey - std::sin(heading) * ex < 0 ? -t : t};
+}
+
+double FrenetTable::roadS(LaneHandle lane, double s) const {
+  auto samples = this->samples(lane);
+  double u;
+  auto i = locate(samples, s, &Sample::s, &u);
+  return samples[i].roadS + u * (samples[i + 1].roadS - samples[i].roadS);
+}
+
+double FrenetTable::laneS(LaneHandle lane, double road_s) const {
+  auto samples = this->samples(lane);
+  double u;
+  auto i = locate(samples, road_s, &Sample::roadS, &u);
+  return samples[i].s + u * (samples[i + 1].s - samples[i].s);
+}
+
+void FrenetTable::poses(Span<const LaneHandle> lanes, Span<const double> s,
+                        std::vector<FrenetPose>* results, ThreadPool* pool) const {
+  if (lanes.size() != s.size()) throw std::invalid_argument("lanes and s differ in size");
+  results->resize(lanes.size());
+  forBatches(lanes.size(), pool, [this, &lanes, &s, results](std::size_t i) {
+    (*results)[i] = pose(lanes[i], s[i]);
+  });
+}
+
+void FrenetTable::positions(Span<const LaneHandle> lanes, Span<const Point> points,
+                            std::vector<FrenetPosition>* results, ThreadPool* pool) const {
+  if (lanes.size() != points.size()) throw std::invalid_argument("lanes and points differ in size");
+  results->resize(lanes.size());
+  forBatches(lanes.size(), pool, [this, &lanes, &points, results](std::size_t i) {
+    (*results)[i] = position(lanes[i], points[i]);
+  });
+}
+
+}  // namespace tsim
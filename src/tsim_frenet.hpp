@@ -0,0 +1,100 @@
+#ifndef __TSIM_FRENET_HPP__
+#define __TSIM_FRENET_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tsim_map.hpp"
+#include "tsim_util.hpp"
+
+namespace tsim {
+
+class ThreadPool;
+
+// point of a lane center line at arc length s, heading is the direction of the center line
+// towards increasing s and roadS the position along the road
+struct FrenetPose {
+  double x{0};
+  double y{0};
+  double heading{0};
+  double roadS{0};
+};
+
+// position relative to a lane: s along the center line, t the signed distance from it, positive
+// to the left
+struct FrenetPosition {
+  double s{0};
+  double t{0};
+};
+
+// Arc length tables of the center lines of all lanes of a map, for transforms between world
+// coordinates and lane coordinates (s, t). s of a lane is the distance along its center line from
+// the start of its lane section in the direction of the road, also on left lanes that are driven
+// against it. The center line is sampled from the road geometry (Lane::evaluate) until the chord
+// between two samples deviates less than a tolerance, independent of the tessellation and of lazy
+// geometry. Each lane stores its samples with their cumulative chord length; s -> pose is a binary
+// search plus interpolation, (x, y) -> (s, t) a projection onto the nearest chord of the lane.
+// Lanes are stored by handle like in the map, replaced lanes of a reloaded map keep their table.
+// The table is not changed after construction and can be read by any number of threads.
+class FrenetTable {
+public:
+  // all lanes of map. Lanes are sampled by the threads of pool, if given.
+  explicit FrenetTable(const Map& map, ThreadPool* pool = nullptr);
+  // the lanes of previous and the lanes added to map since, see parser::OpenDriveParser::reload
+  FrenetTable(const Map& map, const FrenetTable& previous, ThreadPool* pool = nullptr);
+
+  // false for lanes added to the map after the table was built
+  bool contains(LaneHandle lane) const {
+    return lane + 1 < m_laneStart.size();
+  }
+  // length of the center line [m]
+  double length(LaneHandle lane) const;
+  // pose at s (clamped to the lane)
+  FrenetPose pose(LaneHandle lane, double s) const;
+  // p relative to the lane, projected onto the nearest point of the center line. Searches all
+  // chords of the lane. Points beyond the ends get s of the end and their distance to it.
+  FrenetPosition position(LaneHandle lane, const Point& p) const;
+  // conversion between s of the lane and s along the road (both clamped to the lane)
+  double roadS(LaneHandle lane, double s) const;
+  double laneS(LaneHandle lane, double road_s) const;
+
+  // pose(lanes[i], s[i]) and position(lanes[i], points[i]) in results[i], split among the threads
+  // of pool
+  void poses(Span<const LaneHandle> lanes, Span<const double> s, std::vector<FrenetPose>* results,
+             ThreadPool* pool = nullptr) const;
+  void positions(Span<const LaneHandle> lanes, Span<const Point> points,
+                 std::vector<FrenetPosition>* results, ThreadPool* pool = nullptr) const;
+
+  std::size_t lanes() const {
+    return m_laneStart.empty() ? 0 : m_laneStart.size() - 1;
+  }
+  std::size_t samples() const {
+    return m_samples.size();
+  }
+
+private:
+  struct Sample {
+    double s;
+    double roadS;
+    double x;
+    double y;
+    double heading;
+  };
+  // samples of lanes [first, map lanes) appended to the table
+  void addLanes(const Map& map, std::size_t first, ThreadPool* pool);
+  static void sampleLane(const Lane& lane, std::vector<Sample>* samples);
+  // samples between a and b until the chords are within the tolerance
+  static void refine(const Lane& lane, Sample a, Sample b, int depth, std::vector<Sample>* samples);
+  // sample at road_s, s is set from the chords
+  static Sample evaluate(const Lane& lane, double road_s);
+  Span<const Sample> samples(LaneHandle lane) const;
+
+  // samples of lane h are m_samples[m_laneStart[h]] to m_samples[m_laneStart[h + 1]]
+  std::vector<uint32_t> m_laneStart;
+  std::vector<Sample> m_samples;
+};
+
+}  // namespace tsim
+
+#endif  // __TSIM_FRENET_HPP__
@@ -0,0 +1,119 @@
+#include "tsim_geometry_cache.hpp"
+
+#include <stdexcept>
+#include <string>
+
+namespace tsim {
+
+std::shared_ptr<const std::vector<Point>> GeometryCache::boundary(
+  SectionHandle lane_section, std::size_t index, const BoundaryGenerator& generator) {
+  Key key{lane_section, index};
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+      m_recentlyUsed.splice(m_recentlyUsed.begin(), m_recentlyUsed, it->second.position);
+      m_statistics.hits++;
+      return it->second.points;
+    }
+  }
+
+  // calculate without holding the lock, other threads keep reading materialized boundaries. The
+  // other boundaries of the section come from the same sampling and are kept as well, callers
+  // usually walk all of them.
+  auto boundaries = generator.boundaries();
+  if (index >= boundaries.size()) {
+    throw std::out_of_range("boundary " + std::to_string(index) + " not found in lane section");
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // the requested boundary is added last, it is the most recently used one and not evicted
+  for (std::size_t i = 0; i < boundaries.size(); i++) {
+    if (i != index) add({lane_section, i}, std::move(boundaries[i]));
+  }
+  auto points = add(key, std::move(boundaries[index]));
+  evict();
+  return points;
+}
+
+std::shared_ptr<const std::vector<Point>> GeometryCache::add(const Key& key,
+                                                            std::vector<Point> points) {
+  auto inserted = m_entries.emplace(key, Entry{});
+  auto& entry = inserted.first->second;
+  if (!inserted.second) {
+    // materialized by another thread in the meantime
+    m_recentlyUsed.splice(m_recentlyUsed.begin(), m_recentlyUsed, entry.position);
+    return entry.points;
+  }
+  entry.points = std::make_shared<const std::vector<Point>>(std::move(points));
+  m_recentlyUsed.push_front(key);
+  entry.position = m_recentlyUsed.begin();
+  m_statistics.materialized++;
+  m_statistics.residentPoints += entry.points->size();
+  return entry.points;
+}
+
+void GeometryCache::evict() {
+  // the most recently used boundary is never evicted, a single boundary may exceed the limit
+  while (m_maxPoints > 0 && m_statistics.residentPoints > m_maxPoints &&
+         m_recentlyUsed.size() > 1) {
+    auto it = m_entries.find(m_recentlyUsed.back());
+    m_statistics.residentPoints -= it->second.points->size();
+    m_statistics.evictions++;
+    m_entries.erase(it);
+    m_recentlyUsed.pop_back();
+  }
+}
+
+void GeometryCache::setCoarse(SectionHandle lane_section, SectionBoundaries boundaries) {
+  auto coarse = std::make_shared<const SectionBoundaries>(std::move(boundaries));
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_coarse[lane_section] = std::move(coarse);
+}
+
+void GeometryCache::insert(SectionHandle lane_section, SectionBoundaries boundaries) {
+  std::size_t points{0};
+  for (const auto& boundary : boundaries) points += boundary.size();
+  auto resident = std::make_shared<const SectionBoundaries>(std::move(boundaries));
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto& entry = m_sections[lane_section];
+  if (entry) {
+    for (const auto& boundary : *entry) m_statistics.residentPoints -= boundary.size();
+  }
+  entry = std::move(resident);
+  m_statistics.materialized++;
+  m_statistics.residentPoints += points;
+}
+
+void GeometryCache::erase(SectionHandle lane_section) {
+  // readers keep their snapshot, the points are freed by the last of them
+  std::shared_ptr<const SectionBoundaries> released;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_sections.find(lane_section);
+  if (it == m_sections.end()) return;
+  released = std::move(it->second);
+  m_sections.erase(it);
+  for (const auto& boundary : *released) m_statistics.residentPoints -= boundary.size();
+  m_statistics.evictions++;
+}
+
+std::shared_ptr<const GeometryCache::SectionBoundaries> GeometryCache::sectionBoundaries(
+  SectionHandle lane_section) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_sections.find(lane_section);
+  if (it != m_sections.end()) {
+    m_statistics.hits++;
+    return it->second;
+  }
+  auto coarse = m_coarse.find(lane_section);
+  if (coarse == m_coarse.end()) return nullptr;
+  m_statistics.coarseHits++;
+  return coarse->second;
+}
+
+GeometryCache::Statistics GeometryCache::statistics() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_statistics;
+}
+
+}  // namespace tsim
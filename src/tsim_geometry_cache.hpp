@@ -0,0 +1,104 @@
+#ifndef __TSIM_GEOMETRY_CACHE_HPP__
+#define __TSIM_GEOMETRY_CACHE_HPP__
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tsim_util.hpp"
+
+namespace tsim {
+
+using SectionHandle = uint32_t;
+
+// Calculates the lane boundaries of a lane section on demand from a compact description of its
+// geometry. Implemented by the map source, e.g. the OpenDRIVE parser.
+class BoundaryGenerator {
+public:
+  virtual ~BoundaryGenerator() = default;
+
+  virtual std::size_t boundaryCount() const = 0;
+  // all boundaries of the section, the geometry is sampled once for all of them
+  virtual std::vector<std::vector<Point>> boundaries() const = 0;
+};
+
+// Lane boundaries materialized by BoundaryGenerators, shared by all lane sections of a map.
+// Thread-safe. With a point limit the least recently used boundaries are evicted once more points
+// are resident, boundaries still referenced by a caller stay valid until released.
+//
+// A streamed cache (see MapStreamer) does not calculate on access: all boundaries of a lane section
+// are inserted and erased together by the streamer, sections that are not resident return their
+// coarse boundaries.
+class GeometryCache {
+public:
+  struct Statistics {
+    std::size_t materialized{0};
+    std::size_t hits{0};
+    std::size_t evictions{0};
+    std::size_t residentPoints{0};
+    std::size_t coarseHits{0};  // streamed: lookups of sections that were not resident
+  };
+  using SectionBoundaries = std::vector<std::vector<Point>>;
+
+  explicit GeometryCache(std::size_t max_points = 0)  // 0: no limit
+      : m_maxPoints(max_points){};
+
+  // lane sections are identified by their handle, a cache belongs to one map. A miss materializes
+  // all boundaries of the section.
+  std::shared_ptr<const std::vector<Point>> boundary(SectionHandle lane_section, std::size_t index,
+                                                     const BoundaryGenerator& generator);
+  Statistics statistics() const;
+
+  // streamed geometry. Coarse boundaries of every section are set before the cache is switched to
+  // streaming and stay resident, sectionBoundaries never returns nullptr for them.
+  void setCoarse(SectionHandle lane_section, SectionBoundaries boundaries);
+  void setStreamed() {
+    m_streamed = true;
+  }
+  bool streamed() const {
+    return m_streamed;
+  }
+  void insert(SectionHandle lane_section, SectionBoundaries boundaries);
+  void erase(SectionHandle lane_section);
+  // all boundaries of the section at the same level of detail, nullptr for sections the streamer
+  // does not know (added after streaming started)
+  std::shared_ptr<const SectionBoundaries> sectionBoundaries(SectionHandle lane_section);
+
+private:
+  using Key = std::pair<SectionHandle, std::size_t>;
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const {
+      return std::hash<SectionHandle>()(key.first) * 31 + key.second;
+    }
+  };
+  struct Entry {
+    std::shared_ptr<const std::vector<Point>> points;
+    std::list<Key>::iterator position;  // in m_recentlyUsed
+  };
+
+  // materialized points of key, unless another thread added them first. Locked by the caller.
+  std::shared_ptr<const std::vector<Point>> add(const Key& key, std::vector<Point> points);
+  void evict();
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<Key, Entry, KeyHash> m_entries;
+  std::list<Key> m_recentlyUsed;  // most recently used first
+  std::size_t m_maxPoints{0};
+  Statistics m_statistics;
+
+  std::atomic<bool> m_streamed{false};
+  std::unordered_map<SectionHandle, std::shared_ptr<const SectionBoundaries>> m_sections;
+  std::unordered_map<SectionHandle, std::shared_ptr<const SectionBoundaries>> m_coarse;
+};
+
+}  // namespace tsim
+
+#endif  // __TSIM_GEOMETRY_CACHE_HPP__
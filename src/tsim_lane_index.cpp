@@ -0,0 +1,281 @@
+#include "tsim_lane_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "tsim_thread_pool.hpp"
+
+namespace tsim {
+
+namespace {
+// automatic cell size: about this many quads per cell, cells are at least MIN_CELL_SIZE wide
+constexpr double QUADS_PER_CELL{2};
+constexpr double MIN_CELL_SIZE{1};
+// a smaller explicit cell size is raised until the grid has at most this many cells per quad
+constexpr double MAX_CELLS_PER_QUAD{64};
+// points of a batch query matched by one job
+constexpr std::size_t BATCH_POINTS{256};
+
+double squaredSegmentDistance(double x, double y, double x0, double y0, double x1, double y1) {
+  double dx = x1 - x0;
+  double dy = y1 - y0;
+  double length2 = dx * dx + dy * dy;
+  double t = length2 > 0 ? std::clamp(((x - x0) * dx + (y - y0) * dy) / length2, 0.0, 1.0) : 0.0;
+  double ex = x - (x0 + t * dx);
+  double ey = y - (y0 + t * dy);
+  return ex * ex + ey * ey;
+}
+}  // namespace
+
+LaneIndex::LaneIndex(const Map& map, LaneIndexOptions options, ThreadPool* pool)
+    : m_options(options) {
+  if (m_options.cellSize < 0) throw std::invalid_argument("cell size must not be negative");
+  auto roads = map.roads();
+  std::vector<std::vector<Quad>> roadQuads(roads.size());
+  auto collect = [this, &roads, &roadQuads](std::size_t i) {
+    for (const auto& section : roads[i].sections()) {
+      for (const auto& lane : section.lanes()) {
+        if (lane.m_id == 0) continue;
+        if (m_options.drivingOnly && lane.m_type != LaneType::eDRIVING) continue;
+        auto boundaries = section.boundaries(lane.m_innerBoundary, lane.m_outerBoundary);
+        const auto& inner = boundaries.first;
+        const auto& outer = boundaries.second;
+        for (std::size_t j = 0; j + 1 < std::min(inner.size(), outer.size()); j++) {
+          Quad quad{{inner[j].x, inner[j + 1].x, outer[j + 1].x, outer[j].x},
+                    {inner[j].y, inner[j + 1].y, outer[j + 1].y, outer[j].y},
+                    {},
+                    {},
+                    lane.m_handle,
+                    static_cast<uint32_t>(j)};
+          quad.low[0] = *std::min_element(quad.x, quad.x + 4);
+          quad.low[1] = *std::min_element(quad.y, quad.y + 4);
+          quad.high[0] = *std::max_element(quad.x, quad.x + 4);
+          quad.high[1] = *std::max_element(quad.y, quad.y + 4);
+          roadQuads[i].push_back(quad);
+        }
+      }
+    }
+  };
+  if (pool) {
+    pool->parallelFor(roads.size(), collect);
+  } else {
+    for (std::size_t i = 0; i < roads.size(); i++) collect(i);
+  }
+  std::size_t count{0};
+  for (const auto& quads : roadQuads) count += quads.size();
+  m_quads.reserve(count);
+  for (auto& quads : roadQuads) {
+    m_quads.insert(m_quads.end(), quads.begin(), quads.end());
+    std::vector<Quad>().swap(quads);
+  }
+  if (m_quads.empty()) return;
+
+  m_minX = m_quads.front().low[0];
+  m_minY = m_quads.front().low[1];
+  double maxX = m_quads.front().high[0];
+  double maxY = m_quads.front().high[1];
+  for (const auto& quad : m_quads) {
+    m_minX = std::min<double>(m_minX, quad.low[0]);
+    m_minY = std::min<double>(m_minY, quad.low[1]);
+    maxX = std::max<double>(maxX, quad.high[0]);
+    maxY = std::max<double>(maxY, quad.high[1]);
+  }
+  m_cellSize = m_options.cellSize;
+  if (m_cellSize == 0) {
+    double area = std::max(maxX - m_minX, MIN_CELL_SIZE) * std::max(maxY - m_minY, MIN_CELL_SIZE);
+    m_cellSize = std::max(MIN_CELL_SIZE, std::sqrt(area * QUADS_PER_CELL / m_quads.size()));
+  }
+  // cells are numbered with 32 bits, beyond a few per quad more cells only cost memory
+  double maxCells = std::min<double>(UINT32_MAX - 1, MAX_CELLS_PER_QUAD * m_quads.size());
+  auto cells = [this, maxX, maxY]() {
+    return (std::floor((maxX - m_minX) / m_cellSize) + 1) *
+           (std::floor((maxY - m_minY) / m_cellSize) + 1);
+  };
+  while (cells() > maxCells) m_cellSize *= 2;
+  m_columns = column(maxX) + 1;
+  m_rows = row(maxY) + 1;
+
+  // cells of every quad. Long quads (straight lanes are two points) are split along the lane into
+  // pieces no longer than a cell, each piece adds the cells of its bounding box.
+  std::vector<std::pair<uint32_t, uint32_t>> entries;  // cell, quad
+  std::vector<uint32_t> quadCells;
+  for (std::size_t q = 0; q < m_quads.size(); q++) {
+    const auto& quad = m_quads[q];
+    double length = std::max(std::hypot(quad.x[1] - quad.x[0], quad.y[1] - quad.y[0]),
+                             std::hypot(quad.x[2] - quad.x[3], quad.y[2] - quad.y[3]));
+    auto pieces =
+      std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(length / m_cellSize)));
+    quadCells.clear();
+    for (std::size_t k = 0; k < pieces; k++) {
+      double t0 = static_cast<double>(k) / pieces;
+      double t1 = static_cast<double>(k + 1) / pieces;
+      double low[2] = {maxX, maxY};
+      double high[2] = {m_minX, m_minY};
+      for (double t : {t0, t1}) {
+        // inner edge from corner 0 to 1, outer edge from corner 3 to 2
+        for (auto [a, b] : {std::pair<int, int>{0, 1}, std::pair<int, int>{3, 2}}) {
+          double x = quad.x[a] + t * (quad.x[b] - quad.x[a]);
+          double y = quad.y[a] + t * (quad.y[b] - quad.y[a]);
+          low[0] = std::min(low[0], x);
+          low[1] = std::min(low[1], y);
+          high[0] = std::max(high[0], x);
+          high[1] = std::max(high[1], y);
+        }
+      }
+      for (auto r = row(low[1]); r <= row(high[1]); r++) {
+        for (auto c = column(low[0]); c <= column(high[0]); c++) {
+          quadCells.push_back(static_cast<uint32_t>(r * m_columns + c));
+        }
+      }
+    }
+    std::sort(quadCells.begin(), quadCells.end());
+    quadCells.erase(std::unique(quadCells.begin(), quadCells.end()), quadCells.end());
+    for (auto cell : quadCells) entries.emplace_back(cell, static_cast<uint32_t>(q));
+  }
+
+  // counting sort by cell
+  m_cellStart.assign(m_columns * m_rows + 1, 0);
+  for (const auto& entry : entries) m_cellStart[entry.first + 1]++;
+  for (std::size_t c = 1; c < m_cellStart.size(); c++) m_cellStart[c] += m_cellStart[c - 1];
+  m_cellQuads.resize(entries.size());
+  std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+  for (const auto& entry : entries) m_cellQuads[fill[entry.first]++] = entry.second;
+}
+
+double LaneIndex::squaredDistance(const Quad& quad, double x, double y, double limit) {
+  // the bounding box rejects most quads of a cell before the exact test
+  double dx = std::max({quad.low[0] - x, 0.0, x - quad.high[0]});
+  double dy = std::max({quad.low[1] - y, 0.0, y - quad.high[1]});
+  if (dx * dx + dy * dy > limit) return dx * dx + dy * dy;
+  // crossings of a ray from the point in +x direction with the edges, odd inside. Also holds for
+  // quads folded at tight curves.
+  bool inside{false};
+  for (int k = 0, l = 3; k < 4; l = k++) {
+    if ((quad.y[k] > y) == (quad.y[l] > y)) continue;
+    // the edge crosses the ray right of x
+    double cross =
+      (quad.x[l] - quad.x[k]) * (y - quad.y[k]) - (x - quad.x[k]) * (quad.y[l] - quad.y[k]);
+    if (quad.y[l] > quad.y[k] ? cross > 0 : cross < 0) inside = !inside;
+  }
+  if (inside) return 0;
+  double result{std::numeric_limits<double>::max()};
+  for (int k = 0, l = 3; k < 4; l = k++) {
+    result =
+      std::min(result, squaredSegmentDistance(x, y, quad.x[k], quad.y[k], quad.x[l], quad.y[l]));
+  }
+  return result;
+}
+
+int64_t LaneIndex::column(double x) const {
+  return static_cast<int64_t>(std::floor((x - m_minX) / m_cellSize));
+}
+
+int64_t LaneIndex::row(double y) const {
+  return static_cast<int64_t>(std::floor((y - m_minY) / m_cellSize));
+}
+
+template <typename Fn>
+void LaneIndex::forQuads(int64_t column0, int64_t column1, int64_t row0, int64_t row1,
+                         Fn fn) const {
+  column0 = std::max<int64_t>(column0, 0);
+  column1 = std::min(column1, m_columns - 1);
+  row0 = std::max<int64_t>(row0, 0);
+  row1 = std::min(row1, m_rows - 1);
+  for (auto r = row0; r <= row1; r++) {
+    for (auto c = column0; c <= column1; c++) {
+      auto cell = r * m_columns + c;
+      for (auto i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++) fn(m_cellQuads[i]);
+    }
+  }
+}
+
+void LaneIndex::lanesAt(const Point& p, std::vector<LaneMatch>* matches) const {
+  // all distances are 0, withinRadius orders by lane
+  withinRadius(p, 0, matches);
+}
+
+LaneMatch LaneIndex::nearest(const Point& p, double max_distance) const {
+  LaneMatch best;
+  if (m_cellQuads.empty()) return best;
+  // squared distances until the end
+  double limit = max_distance * max_distance;
+  auto visit = [this, &p, &best, &limit](uint32_t q) {
+    const auto& quad = m_quads[q];
+    double d = squaredDistance(quad, p.x, p.y, limit);
+    if (d > limit) return;
+    if (best.lane == INVALID_HANDLE || d < best.distance ||
+        (d == best.distance && quad.lane < best.lane)) {
+      best = {quad.lane, quad.segment, d};
+      limit = d;
+    }
+  };
+  // rings of cells around the cell of p. Ring r lies outside the square of the rings before, the
+  // search ends once that square contains the circle of the best distance. Rings beyond the last
+  // one that touches the grid are empty.
+  auto x = column(p.x);
+  auto y = row(p.y);
+  auto lastRing = std::max({x, m_columns - 1 - x, y, m_rows - 1 - y});
+  for (int64_t r = 0; r <= lastRing; r++) {
+    double inner = std::min({p.x - (m_minX + (x - r + 1) * m_cellSize),
+                             m_minX + (x + r) * m_cellSize - p.x,
+                             p.y - (m_minY + (y - r + 1) * m_cellSize),
+                             m_minY + (y + r) * m_cellSize - p.y});
+    if (r > 0 && inner * inner > limit) break;
+    if (r == 0) {
+      forQuads(x, x, y, y, visit);
+      continue;
+    }
+    forQuads(x - r, x + r, y - r, y - r, visit);
+    forQuads(x - r, x + r, y + r, y + r, visit);
+    forQuads(x - r, x - r, y - r + 1, y + r - 1, visit);
+    forQuads(x + r, x + r, y - r + 1, y + r - 1, visit);
+  }
+  best.distance = std::sqrt(best.distance);
+  return best;
+}
+
+void LaneIndex::withinRadius(const Point& p, double radius, std::vector<LaneMatch>* matches) const {
+  matches->clear();
+  if (m_cellQuads.empty()) return;
+  forQuads(column(p.x - radius), column(p.x + radius), row(p.y - radius), row(p.y + radius),
+           [this, &p, radius, matches](uint32_t q) {
+             const auto& quad = m_quads[q];
+             double d = squaredDistance(quad, p.x, p.y, radius * radius);
+             if (d <= radius * radius) matches->push_back({quad.lane, quad.segment, std::sqrt(d)});
+           });
+  // one match per lane, its nearest quad
+  std::sort(matches->begin(), matches->end(), [](const LaneMatch& a, const LaneMatch& b) {
+    return std::tie(a.lane, a.distance, a.segment) < std::tie(b.lane, b.distance, b.segment);
+  });
+  matches->erase(std::unique(matches->begin(), matches->end(),
+                             [](const LaneMatch& a, const LaneMatch& b) {
+                               return a.lane == b.lane;
+                             }),
+                 matches->end());
+  std::stable_sort(matches->begin(), matches->end(), [](const LaneMatch& a, const LaneMatch& b) {
+    return a.distance < b.distance;
+  });
+}
+
+void LaneIndex::nearest(Span<const Point> points, double max_distance,
+                        std::vector<LaneMatch>* matches, ThreadPool* pool) const {
+  matches->resize(points.size());
+  auto batches = (points.size() + BATCH_POINTS - 1) / BATCH_POINTS;
+  auto match = [this, &points, max_distance, matches](std::size_t batch) {
+    auto end = std::min(points.size(), (batch + 1) * BATCH_POINTS);
+    for (auto i = batch * BATCH_POINTS; i < end; i++) {
+      (*matches)[i] = nearest(points[i], max_distance);
+    }
+  };
+  if (pool && batches > 1) {
+    pool->parallelFor(batches, match);
+  } else {
+    for (std::size_t batch = 0; batch < batches; batch++) match(batch);
+  }
+}
+
+}  // namespace tsim
@@ -0,0 +1,101 @@
+#ifndef __TSIM_LANE_INDEX_HPP__
+#define __TSIM_LANE_INDEX_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tsim_map.hpp"
+#include "tsim_util.hpp"
+
+namespace tsim {
+
+class ThreadPool;
+
+struct LaneIndexOptions {
+  // edge length of the grid cells [m], 0: chosen from the map extent. A size that would give far
+  // more cells than quads is raised, see LaneIndex::cellSize().
+  double cellSize{0};
+  bool drivingOnly{false};  // only lanes of type eDRIVING
+};
+
+// Lane found for a position. segment is the index of the boundary points the matched quad starts
+// at, distance is 0 inside the lane.
+struct LaneMatch {
+  LaneHandle lane{INVALID_HANDLE};
+  uint32_t segment{0};
+  double distance{0};
+};
+
+// Uniform grid over the lane geometry of a map, for matching world positions to lanes (spawning,
+// co-simulated vehicles, sensors). The lane between two consecutive points of its inner and outer
+// boundary is one quad, each grid cell lists the quads that overlap it (stored like the link table
+// of the map, one array of offsets and one of quads). Queries work in the x-y plane, lanes above
+// each other (bridges) both match. The quad corners are copied at construction, the index is not
+// changed afterwards and can be read by any number of threads. It does not follow changes of the
+// map, see parser::OpenDriveParser::reload.
+class LaneIndex {
+public:
+  // all lanes except center lanes. Boundaries of lazily loaded maps are calculated, streamed
+  // sections contribute the boundaries they have at that time. Lanes are read by the threads of
+  // pool, if given.
+  explicit LaneIndex(const Map& map, LaneIndexOptions options = {}, ThreadPool* pool = nullptr);
+
+  // lanes containing p, ordered by lane handle
+  void lanesAt(const Point& p, std::vector<LaneMatch>* matches) const;
+  // nearest lane within max_distance [m] of p, lane is INVALID_HANDLE if there is none
+  LaneMatch nearest(const Point& p, double max_distance) const;
+  // lanes within radius [m] of p with their nearest quad, ordered by distance
+  void withinRadius(const Point& p, double radius, std::vector<LaneMatch>* matches) const;
+  // nearest(points[i], max_distance) in matches[i], the points are split among the threads of pool
+  void nearest(Span<const Point> points, double max_distance, std::vector<LaneMatch>* matches,
+               ThreadPool* pool = nullptr) const;
+
+  const LaneIndexOptions& options() const {
+    return m_options;
+  }
+  double cellSize() const {
+    return m_cellSize;
+  }
+  std::size_t quads() const {
+    return m_quads.size();
+  }
+  std::size_t cells() const {
+    return m_cellStart.empty() ? 0 : m_cellStart.size() - 1;
+  }
+
+private:
+  // corners in order inner[i], inner[i + 1], outer[i + 1], outer[i], and their bounding box
+  struct Quad {
+    float x[4];
+    float y[4];
+    float low[2];
+    float high[2];
+    LaneHandle lane;
+    uint32_t segment;
+  };
+  // squared distance of (x, y) to the quad, 0 inside. Values above limit may be a lower bound.
+  static double squaredDistance(const Quad& quad, double x, double y, double limit);
+  // grid cell of a coordinate, may be outside the grid
+  int64_t column(double x) const;
+  int64_t row(double y) const;
+  // calls fn(quad index) for the quads of the cells in [column0, column1] x [row0, row1], clamped
+  // to the grid. Quads overlapping several cells are visited more than once.
+  template <typename Fn>
+  void forQuads(int64_t column0, int64_t column1, int64_t row0, int64_t row1, Fn fn) const;
+
+  LaneIndexOptions m_options;
+  double m_minX{0};
+  double m_minY{0};
+  double m_cellSize{1};
+  int64_t m_columns{0};
+  int64_t m_rows{0};
+  std::vector<Quad> m_quads;
+  // quads of cell c (row major) are m_cellQuads[m_cellStart[c]] to m_cellQuads[m_cellStart[c + 1]]
+  std::vector<uint32_t> m_cellStart;
+  std::vector<uint32_t> m_cellQuads;
+};
+
+}  // namespace tsim
+
+#endif  // __TSIM_LANE_INDEX_HPP__
@@ -1,72 +1,371 @@
 
 #include "tsim_map.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <thread>
+
+#include "tsim_geometry_cache.hpp"
 namespace tsim {
 
-std::shared_ptr<Lane> LaneSection::lane(int lid) const {
-  auto iterator =
-    std::find_if(m_lanes.begin(), m_lanes.end(), [lid](const std::shared_ptr<Lane>& lane) {
-      return lane->id() == lid;
-    });
-  if (iterator == m_lanes.end()) {
-    throw std::logic_error("lane " + std::to_string(lid) + "not found in Road " +
-                           std::to_string(this->m_road->id()));
+namespace {
+// relative error of the clothoid position from the Fresnel integrals, grows with the distance to
+// the clothoid's origin
+constexpr double FRESNEL_PRECISION{1e-15};
+// Fresnel integrals are constant beyond this argument in double precision
+constexpr double FRESNEL_MAX{3e4};
+// the dense table of an IdIndex covers ids up to this many times its entries, at least
+// DENSE_MIN_IDS (256 kB), junction ids often share the numbering of the roads
+constexpr std::size_t DENSE_FACTOR{4};
+constexpr std::size_t DENSE_MIN_IDS{1 << 16};
+}  // namespace
+
+void IdIndex::insert(uint32_t id, uint32_t handle) {
+  if (m_size == 0 && m_dense.empty() && id >= DENSE_MIN_IDS) m_base = id;
+  uint32_t index = id - m_base;
+  if (index < m_dense.size()) {
+    if (m_dense[index] == INVALID_HANDLE) m_size++;
+    m_dense[index] = handle;
+    return;
+  }
+  auto limit = std::max(DENSE_MIN_IDS, (m_size + 1) * DENSE_FACTOR);
+  if (index >= limit) {
+    if (m_sparse.insert_or_assign(id, handle).second) m_size++;
+    return;
+  }
+  // grow the table by doubling, sparse ids it covers now move into it
+  m_dense.resize(std::min(limit, std::max<std::size_t>(index + 1, m_dense.size() * 2)),
+                 INVALID_HANDLE);
+  for (auto it = m_sparse.begin(); it != m_sparse.end();) {
+    if (it->first - m_base < m_dense.size()) {
+      m_dense[it->first - m_base] = it->second;
+      it = m_sparse.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  m_dense[index] = handle;
+  m_size++;
+}
+
+void IdIndex::erase(uint32_t id) {
+  if (id - m_base < m_dense.size()) {
+    if (m_dense[id - m_base] != INVALID_HANDLE) m_size--;
+    m_dense[id - m_base] = INVALID_HANDLE;
+  } else {
+    m_size -= m_sparse.erase(id);
+  }
+}
+
+void IdIndex::clear() {
+  m_base = 0;
+  m_dense.clear();
+  m_sparse.clear();
+  m_size = 0;
+}
+
+const Lane* LaneSection::findLane(int lid) const {
+  auto lanes = this->lanes();
+  if (lanes.empty()) return nullptr;
+  auto index = static_cast<std::size_t>(static_cast<int64_t>(lanes[0].m_id) - lid);
+  if (index < lanes.size() && lanes[index].m_id == lid) return &lanes[index];
+  auto iterator = std::find_if(lanes.begin(), lanes.end(), [lid](const Lane& lane) {
+    return lane.m_id == lid;
+  });
+  return iterator != lanes.end() ? &*iterator : nullptr;
+}
+const Lane& LaneSection::lane(int lid) const {
+  const auto* lane = findLane(lid);
+  if (!lane) {
+    throw std::logic_error("lane " + std::to_string(lid) + " not found in Road " +
+                           std::to_string(road().id()));
   }
-  return *iterator;
+  return *lane;
 }
-std::shared_ptr<Lane> Road::getFirstLane() {
-  auto laneSection = m_sections.front();
-  auto lanes = laneSection->lanes();
-  return lanes.front();
+const Lane& Road::getFirstLane() const {
+  return sections().front().lanes().front();
 };
 
-std::shared_ptr<Road> Map::findRoadById(int rid) {
-  auto iterator =
-    std::find_if(m_roads.begin(), m_roads.end(), [rid](const std::shared_ptr<Road>& road) {
-      return road->id() == rid;
-    });
-  if (iterator != m_roads.end()) {
-    return (*iterator);
+const Road* Map::findRoadById(int rid) const {
+  auto handle = m_roadIndex.find(static_cast<uint32_t>(rid));
+  return handle != INVALID_HANDLE ? &m_roads[handle] : nullptr;
+}
+const Junction* Map::findJunctionById(int jid) const {
+  auto handle = m_junctionIndex.find(static_cast<uint32_t>(jid));
+  return handle != INVALID_HANDLE ? &m_junctions[handle] : nullptr;
+}
+
+Pose RoadSegment::evaluate(double ds, double t) const {
+  ds = std::min(std::max(ds, 0.0), length);
+  Pose pose;
+  double x1;
+  double y1;
+  evaluate(&ds, 1, &x1, &y1, &pose.heading);
+  double k{0};
+  if (type == SegmentType::eARC) {
+    k = curvature;
+  } else if (type == SegmentType::eSPIRAL) {
+    k = curvature + (curvatureEnd - curvature) * ds / length;
+  } else if (type == SegmentType::ePARAM_POLY3) {
+    double p = ds * pRange / length;
+    double du = (3 * u[3] * p + 2 * u[2]) * p + u[1];
+    double dv = (3 * v[3] * p + 2 * v[2]) * p + v[1];
+    double ddu = 6 * u[3] * p + 2 * u[2];
+    double ddv = 6 * v[3] * p + 2 * v[2];
+    double speed = std::hypot(du, dv);
+    k = speed > 0 ? (du * ddv - dv * ddu) / (speed * speed * speed) : 0;
+  }
+  // curvature of the parallel curve at distance t
+  pose.curvature = k / (1 - k * t);
+  pose.position =
+    Point(x1 - t * std::sin(pose.heading), y1 + t * std::cos(pose.heading), 0.0f);
+  return pose;
+}
+
+void RoadSegment::evaluate(const double* ds, std::size_t n, double* x_out, double* y_out,
+                           double* heading_out) const {
+  if (type == SegmentType::eSPIRAL) {
+    double rate = (curvatureEnd - curvature) / length;  // curvature change per m
+    // the segment is the part of the clothoid (a C(l / a), sgn(rate) a S(l / a)) with curvature
+    // rate * l starting at l0, C and S are the Fresnel integrals
+    double a = std::sqrt(M_PI / std::abs(rate));
+    double l0 = curvature / rate;
+    // deviation from an arc with the mean curvature
+    double arcError = std::abs(rate) * length * length * length / 24;
+    if (arcError > (std::abs(l0) + length) * FRESNEL_PRECISION &&
+        std::max(std::abs(l0), std::abs(l0 + length)) / a < FRESNEL_MAX) {
+      double sign = util::sgn(rate);
+      double z0 = l0 / a;
+      double c0;
+      double s0;
+      util::fresnel(&z0, 1, &c0, &s0);
+      // rotate the clothoid so that its heading rate * l0^2 / 2 at l0 becomes hdg
+      double rotation = hdg - rate * l0 * l0 / 2;
+      double cosRotation = std::cos(rotation);
+      double sinRotation = std::sin(rotation);
+      for (std::size_t i = 0; i < n; i++) x_out[i] = (l0 + ds[i]) / a;
+      util::fresnel(x_out, n, x_out, y_out);
+      for (std::size_t i = 0; i < n; i++) {
+        double dx = a * (x_out[i] - c0);
+        double dy = sign * a * (y_out[i] - s0);
+        x_out[i] = x + cosRotation * dx - sinRotation * dy;
+        y_out[i] = y + sinRotation * dx + cosRotation * dy;
+        heading_out[i] = hdg + ds[i] * (curvature + rate * ds[i] / 2);
+      }
+      return;
+    }
+    // curvature nearly constant
+    RoadSegment arc = *this;
+    arc.type = SegmentType::eARC;
+    arc.curvature = (curvature + curvatureEnd) / 2;
+    arc.evaluate(ds, n, x_out, y_out, heading_out);
+  } else if (type == SegmentType::ePARAM_POLY3) {
+    double scale = length > 0 ? pRange / length : 0;
+    double cosHdg = std::cos(hdg);
+    double sinHdg = std::sin(hdg);
+    for (std::size_t i = 0; i < n; i++) {
+      double p = ds[i] * scale;
+      double pu = ((u[3] * p + u[2]) * p + u[1]) * p + u[0];
+      double pv = ((v[3] * p + v[2]) * p + v[1]) * p + v[0];
+      double du = (3 * u[3] * p + 2 * u[2]) * p + u[1];
+      double dv = (3 * v[3] * p + 2 * v[2]) * p + v[1];
+      x_out[i] = x + cosHdg * pu - sinHdg * pv;
+      y_out[i] = y + sinHdg * pu + cosHdg * pv;
+      heading_out[i] = hdg + std::atan2(dv, du);
+    }
+  } else if (type == SegmentType::eARC && curvature != 0) {
+    for (std::size_t i = 0; i < n; i++) {
+      // along the chord at the mean heading, exact for small curvatures as well
+      double angle = ds[i] * curvature;
+      double chord = 2 * std::sin(angle / 2) / curvature;
+      heading_out[i] = hdg + angle;
+      x_out[i] = x + chord * std::cos(hdg + angle / 2);
+      y_out[i] = y + chord * std::sin(hdg + angle / 2);
+    }
+  } else {
+    double cosHdg = std::cos(hdg);
+    double sinHdg = std::sin(hdg);
+    for (std::size_t i = 0; i < n; i++) {
+      heading_out[i] = hdg;
+      x_out[i] = x + ds[i] * cosHdg;
+      y_out[i] = y + ds[i] * sinHdg;
+    }
+  }
+}
+
+Pose Road::evaluate(double s, double t) const {
+  if (m_segments.empty()) {
+    throw std::logic_error("road " + std::to_string(m_id) + " has no geometry");
+  }
+  // last segment starting at or before s
+  auto segment = std::upper_bound(m_segments.begin(), m_segments.end(), s,
+                                  [](double value, const RoadSegment& element) {
+                                    return value < element.s;
+                                  });
+  if (segment != m_segments.begin()) --segment;
+  // t is measured on the banked surface, its horizontal part moves the point in the plane
+  s = std::min(std::max(s, 0.0), m_length);
+  double bank = superelevation(s);
+  double cosBank = std::cos(bank);
+  auto pose = segment->evaluate(s - segment->s, t * cosBank);
+  pose.position.z = static_cast<float>(elevation(s) + t * std::sin(bank));
+  pose.slope = evaluatePiecewiseDerivative(m_elevations, s) +
+               t * cosBank * evaluatePiecewiseDerivative(m_superelevations, s);
+  pose.bank = bank;
+  return pose;
+}
+
+double evaluatePiecewise(const std::vector<CubicPolynomial>& pieces, double s) {
+  if (pieces.empty()) return 0;
+  // last piece starting at or before s
+  auto piece = std::upper_bound(pieces.begin(), pieces.end(), s,
+                                [](double value, const CubicPolynomial& element) {
+                                  return value < element.sOffset;
+                                });
+  if (piece != pieces.begin()) --piece;
+  return piece->evaluate(s);
+}
+
+double evaluatePiecewiseDerivative(const std::vector<CubicPolynomial>& pieces, double s) {
+  if (pieces.empty()) return 0;
+  auto piece = std::upper_bound(pieces.begin(), pieces.end(), s,
+                                [](double value, const CubicPolynomial& element) {
+                                  return value < element.sOffset;
+                                });
+  if (piece != pieces.begin()) --piece;
+  return piece->derivative(s);
+}
+
+void evaluatePiecewise(const std::vector<CubicPolynomial>& pieces, const double* s, std::size_t n,
+                       double* out) {
+  if (pieces.empty()) {
+    std::fill(out, out + n, 0.0);
+    return;
+  }
+  std::size_t begin{0};
+  for (std::size_t p = 0; p < pieces.size() && begin < n; p++) {
+    // positions before the start of the next piece, the last piece takes all remaining positions
+    std::size_t end = n;
+    if (p + 1 < pieces.size()) {
+      end = begin;
+      while (end < n && s[end] < pieces[p + 1].sOffset) end++;
+    }
+    const auto& piece = pieces[p];
+    for (std::size_t i = begin; i < end; i++) {
+      double ds = s[i] - piece.sOffset;
+      out[i] = ((piece.d * ds + piece.c) * ds + piece.b) * ds + piece.a;
+    }
+    begin = end;
+  }
+}
+
+double Lane::width() const {
+  return width(laneSection().sOffset());
+}
+double Lane::width(double s) const {
+  return evaluatePiecewise(m_widths, s - laneSection().sOffset());
+}
+
+Pose Lane::evaluate(double s) const {
+  double innerRate;
+  double outerRate;
+  const auto& section = laneSection();
+  double t = (section.boundaryOffset(m_innerBoundary, s, &innerRate) +
+              section.boundaryOffset(m_outerBoundary, s, &outerRate)) /
+             2;
+  auto pose = section.road().evaluate(s, t);
+  // on a banked road a lane that moves sideways also climbs
+  pose.slope += (innerRate + outerRate) / 2 * std::sin(pose.bank);
+  return pose;
+}
+
+CenterLine Lane::points() const {
+  auto boundaries = laneSection().boundaries(m_innerBoundary, m_outerBoundary);
+  return {std::move(boundaries.first), std::move(boundaries.second)};
+}
+PointView Lane::boundaryPoints() const {
+  return laneSection().boundary(m_outerBoundary);
+}
+PointView Lane::innerBoundaryPoints() const {
+  return laneSection().boundary(m_innerBoundary);
+}
+
+std::size_t LaneSection::boundaryCount() const {
+  return m_generator ? m_generator->boundaryCount() : m_boundaries.size();
+}
+PointView LaneSection::boundary(std::size_t index) const {
+  if (!m_generator) {
+    return m_boundaries.at(index).points();
+  }
+  if (index >= m_generator->boundaryCount()) {
+    throw std::out_of_range("boundary " + std::to_string(index) + " not found in lane section");
+  }
+  auto& cache = *m_map->m_geometryCache;
+  if (cache.streamed()) {
+    // sections added after streaming started are calculated on access
+    if (auto boundaries = cache.sectionBoundaries(m_handle)) {
+      return {Span<const Point>(boundaries->at(index)), boundaries};
+    }
+  }
+  auto points = cache.boundary(m_handle, index, *m_generator);
+  return {Span<const Point>(*points), points};
+}
+std::pair<PointView, PointView> LaneSection::boundaries(std::size_t first,
+                                                        std::size_t second) const {
+  if (!m_generator || !m_map->m_geometryCache->streamed()) {
+    return {boundary(first), boundary(second)};
+  }
+  // one snapshot, the streamer may replace the coarse boundaries in between two lookups
+  if (std::max(first, second) >= m_generator->boundaryCount()) {
+    throw std::out_of_range("boundary " + std::to_string(std::max(first, second)) +
+                            " not found in lane section");
   }
-  return nullptr;
+  auto snapshot = m_map->m_geometryCache->sectionBoundaries(m_handle);
+  if (!snapshot) return {boundary(first), boundary(second)};
+  return {PointView(Span<const Point>(snapshot->at(first)), snapshot),
+          PointView(Span<const Point>(snapshot->at(second)), snapshot)};
 }
-std::shared_ptr<Junction> Map::findJunctionById(int jid) {
-  auto iterator = std::find_if(m_junctions.begin(), m_junctions.end(),
-                               [jid](const std::shared_ptr<Junction>& junction) {
-                                 return junction->id() == jid;
-                               });
-  return (iterator != m_junctions.end() ? *iterator : nullptr);
-  // if (it != m_junctions.end()) {
-  //   return (*it);
-  // }
-  // return nullptr;
+
+double LaneSection::boundaryOffset(std::size_t index, double s, double* derivative) const {
+  if (index >= boundaryCount()) {
+    throw std::out_of_range("boundary " + std::to_string(index) + " not found in lane section");
+  }
+  // walk inwards from the boundary to the reference line, every lane on the way adds its width
+  const auto& road = this->road();
+  auto lanes = this->lanes();
+  double offset = road.laneOffset(s);
+  if (derivative) *derivative = evaluatePiecewiseDerivative(road.m_laneOffsets, s);
+  while (index != 0) {
+    auto lane = std::find_if(lanes.begin(), lanes.end(), [index](const Lane& lane) {
+      return lane.m_outerBoundary == index;
+    });
+    // inner boundaries are closer to the reference line and have lower indices
+    if (lane == lanes.end() || lane->m_innerBoundary >= index) break;
+    offset += util::sgn(lane->m_id) * lane->width(s);
+    if (derivative) {
+      *derivative +=
+        util::sgn(lane->m_id) * evaluatePiecewiseDerivative(lane->m_widths, s - m_sOffset);
+    }
+    index = lane->m_innerBoundary;
+  }
+  return offset;
 }
 
 double LaneSection::sOffset() const {
   return m_sOffset;
 }
 
-Road::Road(std::shared_ptr<Map> map)
-    : m_map(std::move(map))
-    , m_roadType(RoadType::eROAD){};
-
-std::shared_ptr<Road> Map::getRandomRoad() {
-  auto road = m_roads.at(std::rand() % m_roads.size());
-  auto laneSection = road->sections().front();  // TODO(soeren): multiple lane sections
-  auto lanes = laneSection->lanes();
-  auto iterator = std::find_if(lanes.begin(), lanes.end(), [](const std::shared_ptr<Lane>& lane) {
-    return lane->id() == -1;
+const Road* Map::getRandomRoad() const {
+  const auto& road = roads().at(std::rand() % m_roadOrder.size());
+  auto lanes = road.sections().front().lanes();  // TODO(soeren): multiple lane sections
+  auto iterator = std::find_if(lanes.begin(), lanes.end(), [](const Lane& lane) {
+    return lane.id() == -1;
   });
-  return (iterator != lanes.end() ? road : nullptr);
-  // if (iterator == lanes.end()) {
-  //   return getRandomRoad();
-  // }
-  // return road;
+  return (iterator != lanes.end() ? &road : nullptr);
 }
 }  // namespace tsim
\ No newline at end of file
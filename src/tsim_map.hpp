@@ -4,9 +4,13 @@
 #include <glm/glm.hpp>
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <iterator>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -17,89 +21,412 @@ namespace tsim {
 enum class LaneGroup { eLEFT, eRIGHT, eCENTER };
 enum class RoadType { eROAD, eJUNCTION };
 enum class LaneType { eSIDEWALK, eSHOULDER, eDRIVING, eRESTRICTED, eMEDIAN, ePARKING, eNONE };
+enum class SegmentType { eLINE, eARC, eSPIRAL, ePARAM_POLY3 };
 
 class Map;
 class Road;
 class LaneSection;
+class Lane;
+class MappedFile;
+class BoundaryGenerator;
+class GeometryCache;
+class LaneIndex;
+class FrenetTable;
+
+// Points of a road or lane line. Either owned, or borrowed from a memory mapped map cache that is
+// kept alive by the Map (see MapCache).
+class Polyline {
+public:
+  Span<const Point> points() const {
+    return m_borrowed.data() != nullptr ? m_borrowed : Span<const Point>(m_owned);
+  }
 
-class Lane {
+private:
+  std::vector<Point> m_owned;
+  Span<const Point> m_borrowed;
+
+  friend class MapBuilder;
+};
+
+// Position, heading and curvature at a point of a road or lane. slope is the gradient dz/ds along
+// the road, bank the superelevation (roll around the road direction, positive lifts the left side).
+struct Pose {
+  Point position{0.0f, 0.0f, 0.0f};
+  double heading{0};
+  double curvature{0};
+  double slope{0};
+  double bank{0};
+};
+
+// Geometry primitive of a road's reference line (OpenDRIVE planView geometry). s is the start of
+// the segment along the road.
+struct RoadSegment {
+  SegmentType type{SegmentType::eLINE};
+  double s{0};
+  double x{0};
+  double y{0};
+  double hdg{0};
+  double length{0};
+  double curvature{0};     // arc, spiral: curvature at the start
+  double curvatureEnd{0};  // spiral: curvature at the end
+  // paramPoly3: local coordinates u(p) = u[0] + u[1] p + u[2] p^2 + u[3] p^3 and v(p) for p in
+  // [0, pRange], u along hdg. p is proportional to ds.
+  std::array<double, 4> u{};
+  std::array<double, 4> v{};
+  double pRange{1};
+
+  // pose at ds from the start of the segment (clamped to the segment), moved by t along the left
+  // normal
+  Pose evaluate(double ds, double t = 0) const;
+  // reference line position and heading for n values of ds, without clamping
+  void evaluate(const double* ds, std::size_t n, double* x_out, double* y_out,
+                double* heading_out) const;
+};
+
+// Piece of a piecewise cubic polynomial a + b ds + c ds^2 + d ds^3 with ds = s - sOffset, valid up
+// to the start of the next piece (lane width, lane offset, elevation, superelevation).
+struct CubicPolynomial {
+  double sOffset{0};
+  double a{0};
+  double b{0};
+  double c{0};
+  double d{0};
+
+  double evaluate(double s) const {
+    double ds = s - sOffset;
+    return ((d * ds + c) * ds + b) * ds + a;
+  }
+  double derivative(double s) const {
+    double ds = s - sOffset;
+    return (3 * d * ds + 2 * c) * ds + b;
+  }
+};
+
+// value of a piecewise polynomial (pieces ordered by sOffset) at s, 0 without pieces. The first
+// piece also applies before its sOffset.
+double evaluatePiecewise(const std::vector<CubicPolynomial>& pieces, double s);
+// derivative d/ds at s, 0 without pieces
+double evaluatePiecewiseDerivative(const std::vector<CubicPolynomial>& pieces, double s);
+// values at n ascending positions, each piece is evaluated for all its positions in one loop
+void evaluatePiecewise(const std::vector<CubicPolynomial>& pieces, const double* s, std::size_t n,
+                       double* out);
+
+// Points of a line of the map. Keeps lazily materialized points alive while the view exists, even
+// if the GeometryCache evicts them meanwhile.
+class PointView : public Span<const Point> {
+public:
+  PointView() = default;
+  PointView(Span<const Point> points, std::shared_ptr<const void> owner = nullptr)
+      : Span<const Point>(points)
+      , m_owner(std::move(owner)){};
+
+private:
+  std::shared_ptr<const void> m_owner;
+};
+
+// Points halfway between the inner and outer boundary of a lane. Both boundaries are sampled at
+// the same s positions, the center line is calculated on access and not stored.
+class CenterLine {
 public:
-  explicit Lane(std::shared_ptr<LaneSection> lane_section)
-      : m_laneSection(std::move(lane_section)){};
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Point;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Point;
+
+    const_iterator(const CenterLine* line, std::size_t index)
+        : m_line(line)
+        , m_index(index){};
+    Point operator*() const {
+      return (*m_line)[m_index];
+    }
+    const_iterator& operator++() {
+      m_index++;
+      return *this;
+    }
+    bool operator==(const const_iterator& other) const {
+      return m_index == other.m_index;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return m_index != other.m_index;
+    }
+
+  private:
+    const CenterLine* m_line;
+    std::size_t m_index;
+  };
 
-  const glm::vec3& startPoint() {
-    return m_lanePoints.front();
+  CenterLine(PointView inner, PointView outer)
+      : m_inner(std::move(inner))
+      , m_outer(std::move(outer)){};
+
+  std::size_t size() const {
+    return std::min(m_inner.size(), m_outer.size());
   }
-  double width() const {
-    return m_width;
+  bool empty() const {
+    return size() == 0;
   }
-  double id() const {
-    return m_id;
+  Point operator[](std::size_t i) const {
+    return (m_inner[i] + m_outer[i]) * 0.5f;
   }
-  LaneType laneType() {
-    return m_type;
+  Point at(std::size_t i) const {
+    if (i >= size()) throw std::out_of_range("center line index " + std::to_string(i));
+    return (*this)[i];
+  }
+  Point front() const {
+    return at(0);
+  }
+  Point back() const {
+    return at(size() - 1);
   }
+  const_iterator begin() const {
+    return {this, 0};
+  }
+  const_iterator end() const {
+    return {this, size()};
+  }
+
+private:
+  PointView m_inner;
+  PointView m_outer;
+};
+
+// Objects of a map are stored in flat arrays of the Map and referenced by their index into the
+// array. A handle stays valid for the lifetime of its map, also across reloads (see
+// MapBuilder::editMap).
+using RoadHandle = uint32_t;
+using SectionHandle = uint32_t;
+using LaneHandle = uint32_t;
+using JunctionHandle = uint32_t;
+using ConnectionHandle = uint32_t;
+constexpr uint32_t INVALID_HANDLE{UINT32_MAX};
+
+// consecutive entries of an array of the map, e.g. the lane sections of a road or the successors of
+// a lane in the link table
+struct IndexRange {
+  uint32_t first{0};
+  uint32_t count{0};
+};
 
-  const std::vector<glm::vec3>& points() const {
-    return m_lanePoints;
+// Handles of objects by id. Ids from a base up to a few times the number of entries are stored in a
+// table indexed by id, lookups are one load independent of the map size. The base is 0, or the
+// first id if that is large (e.g. junctions numbered after the roads). Sparse ids (e.g. the id
+// offsets of further tiles of a tiled map) go to a hash map.
+class IdIndex {
+public:
+  // INVALID_HANDLE if the id is unknown
+  uint32_t find(uint32_t id) const {
+    // ids below the base wrap around behind the table
+    if (id - m_base < m_dense.size()) return m_dense[id - m_base];
+    if (m_sparse.empty()) return INVALID_HANDLE;
+    auto it = m_sparse.find(id);
+    return it != m_sparse.end() ? it->second : INVALID_HANDLE;
+  }
+  // adds the id or replaces its handle
+  void insert(uint32_t id, uint32_t handle);
+  void erase(uint32_t id);
+  void clear();
+  std::size_t size() const {
+    return m_size;
   }
-  const std::vector<Point>& boundaryPoints() const {
-    return m_laneBoundaryPoints;
+  // entries in the hash map
+  std::size_t sparseSize() const {
+    return m_sparse.size();
   }
 
-  std::vector<std::shared_ptr<Lane>> predecessors() {
-    return m_successors;
+private:
+  uint32_t m_base{0};
+  std::vector<uint32_t> m_dense;  // by id - m_base, INVALID_HANDLE for unused ids
+  std::unordered_map<uint32_t, uint32_t> m_sparse;
+  std::size_t m_size{0};
+};
+
+// Objects of the map referenced by a list of handles, e.g. the successors of a lane. A view into
+// the map, valid as long as the map is not changed.
+template <typename T> class HandleRange {
+public:
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator(const T* objects, const uint32_t* handle)
+        : m_objects(objects)
+        , m_handle(handle){};
+    const T& operator*() const {
+      return m_objects[*m_handle];
+    }
+    const T* operator->() const {
+      return &m_objects[*m_handle];
+    }
+    const_iterator& operator++() {
+      m_handle++;
+      return *this;
+    }
+    bool operator==(const const_iterator& other) const {
+      return m_handle == other.m_handle;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return m_handle != other.m_handle;
+    }
+
+  private:
+    const T* m_objects;
+    const uint32_t* m_handle;
+  };
+
+  HandleRange() = default;
+  HandleRange(const T* objects, Span<const uint32_t> handles)
+      : m_objects(objects)
+      , m_handles(handles){};
+
+  std::size_t size() const {
+    return m_handles.size();
+  }
+  bool empty() const {
+    return m_handles.empty();
+  }
+  const T& operator[](std::size_t i) const {
+    return m_objects[m_handles[i]];
+  }
+  const T& at(std::size_t i) const {
+    return m_objects[m_handles.at(i)];
+  }
+  const T& front() const {
+    return at(0);
+  }
+  const T& back() const {
+    return at(size() - 1);
   }
-  std::vector<std::shared_ptr<Lane>> successors() {
-    return m_predecessors;
+  const_iterator begin() const {
+    return {m_objects, m_handles.begin()};
   }
+  const_iterator end() const {
+    return {m_objects, m_handles.end()};
+  }
+  Span<const uint32_t> handles() const {
+    return m_handles;
+  }
+
+private:
+  const T* m_objects{nullptr};
+  Span<const uint32_t> m_handles;
+};
+
+class Lane {
+public:
+  Point startPoint() const {
+    return points().front();
+  }
+  // width at the start of the lane section
+  double width() const;
+  // width at s along the road
+  double width(double s) const;
+  double id() const {
+    return m_id;
+  }
+  double offset() const {
+    return m_offset;
+  }
+  LaneType laneType() const {
+    return m_type;
+  }
+  LaneHandle handle() const {
+    return m_handle;
+  }
+
+  // lane center line
+  CenterLine points() const;
+  // outer boundary, away from the reference line
+  PointView boundaryPoints() const;
+  // inner boundary, shared with the outer boundary of the neighbour towards the reference line
+  PointView innerBoundaryPoints() const;
+  // pose of the lane center at s along the road, calculated from the road geometry, lane offset,
+  // lane widths and road profiles. The heading is the heading of the reference line, the position
+  // is on the banked road surface and slope its gradient along the lane.
+  Pose evaluate(double s) const;
+  const LaneSection& laneSection() const;
+
+  HandleRange<Lane> predecessors() const;
+  HandleRange<Lane> successors() const;
 
 private:
-  std::shared_ptr<LaneSection> m_laneSection;
-  std::vector<glm::vec3> m_lanePoints;
-  std::vector<glm::vec3> m_laneBoundaryPoints;
+  const Map* m_map{nullptr};
+  LaneHandle m_handle{0};
+  SectionHandle m_laneSection{0};
+  // indices into the boundary table of the lane section
+  uint32_t m_innerBoundary{0};
+  uint32_t m_outerBoundary{0};
 
-  std::vector<std::shared_ptr<Lane>> m_successors;
-  std::vector<std::shared_ptr<Lane>> m_predecessors;
+  // in the link table of the map
+  IndexRange m_successors;
+  IndexRange m_predecessors;
 
   int32_t m_id{0};
   double m_offset{0.0f};
-  double m_width{0.0f};
+  std::vector<CubicPolynomial> m_widths;  // sOffset relative to the lane section
   LaneType m_type{};
 
   friend class MapBuilder;
+  friend class MapCache;
+  friend class LaneSection;
+  friend class LaneIndex;
+  friend class FrenetTable;
 };
 
 class LaneSection {
 public:
-  explicit LaneSection(std::shared_ptr<Road> road)
-      : m_road(std::move(road)){};
-
-  std::vector<std::shared_ptr<Lane>> lanes() const {
-    return m_lanes;
-  }
+  Span<const Lane> lanes() const;
   double sOffset() const;
-  std::shared_ptr<Lane> lane(int lid) const;
-  std::shared_ptr<Road> road() {
-    return m_road;
-  };
-  std::vector<std::shared_ptr<LaneSection>> predecessors() {
-    return m_predecessors;
+  double length() const {
+    return m_length;
   }
-  std::vector<std::shared_ptr<LaneSection>> successors() {
-    return m_successors;
+  SectionHandle handle() const {
+    return m_handle;
   }
+  // Lanes are usually stored from the leftmost to the rightmost lane with consecutive ids, the lane
+  // is found at its offset from the first id. Other orders are searched.
+  const Lane& lane(int lid) const;
+  // nullptr if the section has no lane lid
+  const Lane* findLane(int lid) const;
+  const Road& road() const;
+  HandleRange<LaneSection> predecessors() const;
+  HandleRange<LaneSection> successors() const;
+  // lane boundaries of the section, index 0 is the reference line. Boundaries between two lanes
+  // are stored once. Lazily loaded sections calculate boundaries on first access, streamed sections
+  // return coarse boundaries while they are not resident (see MapStreamer).
+  std::size_t boundaryCount() const;
+  PointView boundary(std::size_t index) const;
+  // two boundaries sampled at the same s, also while a streamed section changes its detail
+  std::pair<PointView, PointView> boundaries(std::size_t first, std::size_t second) const;
+  // lateral offset of a boundary from the reference line at s along the road, positive to the left:
+  // the lane offset of the road plus the widths of the lanes between the boundary and the center.
+  // derivative, if given, is set to d/ds of the offset.
+  double boundaryOffset(std::size_t index, double s, double* derivative = nullptr) const;
 
 private:
-  std::shared_ptr<Road> m_road;
-  std::vector<std::shared_ptr<Lane>> m_lanes;
+  const Map* m_map{nullptr};
+  SectionHandle m_handle{0};
+  RoadHandle m_road{0};
+  IndexRange m_lanes;
+  std::vector<Polyline> m_boundaries;
+  // lazy geometry, used instead of m_boundaries if set
+  std::shared_ptr<const BoundaryGenerator> m_generator;
 
-  std::vector<std::shared_ptr<LaneSection>> m_successors;
-  std::vector<std::shared_ptr<LaneSection>> m_predecessors;
+  IndexRange m_successors;
+  IndexRange m_predecessors;
 
   double m_sOffset{0.0f};
+  double m_length{0.0f};
 
   friend class MapBuilder;
+  friend class MapCache;
+  friend class MapStreamer;
 };
 
 struct LaneLink {
@@ -127,88 +454,216 @@ private:
   uint32_t m_connectingRoad{0};
 
   friend class MapBuilder;
+  friend class MapCache;
 };
 class Junction {
 public:
-  explicit Junction(std::shared_ptr<Map> map)
-      : m_map(std::move(map)){};
-
   uint32_t id() const {
     return m_id;
   };
-  std::vector<std::shared_ptr<JunctionConnection>> connections() {
-    return m_connections;
-  };
+  JunctionHandle handle() const {
+    return m_handle;
+  }
+  Span<const JunctionConnection> connections() const;
 
 private:
-  std::shared_ptr<Map> m_map;
-  std::vector<std::shared_ptr<JunctionConnection>> m_connections;
+  const Map* m_map{nullptr};
+  JunctionHandle m_handle{0};
+  IndexRange m_connections;
   uint32_t m_id{0};
+
   friend class MapBuilder;
+  friend class MapCache;
 };
 
 class Road {
 public:
-  explicit Road(std::shared_ptr<Map> map);
-
   uint32_t id() const {
     return m_id;
   };
-  const glm::vec3& startPoint() {
-    return m_roadPoints.front();
-  };
-  std::vector<std::shared_ptr<Road>> successors() {
-    return m_successors;
-  };
-  std::vector<std::shared_ptr<Road>> predecessors() {
-    return m_predecessors;
+  RoadHandle handle() const {
+    return m_handle;
+  }
+  const glm::vec3& startPoint() const {
+    return m_roadPoints.points().front();
   };
+  HandleRange<Road> successors() const;
+  HandleRange<Road> predecessors() const;
   int junction() const {
     return m_junction;
   };
-  std::shared_ptr<Lane> getFirstLane();
-  std::vector<std::shared_ptr<LaneSection>> sections() const {
-    return m_sections;
-  };  // Todo not const
-  const std::vector<Point>& points() const {
-    return m_roadPoints;
+  const Lane& getFirstLane() const;
+  Span<const LaneSection> sections() const;
+  Span<const Point> points() const {
+    return m_roadPoints.points();
   };
+  double length() const {
+    return m_length;
+  }
+  // reference line geometry, ordered by s
+  const std::vector<RoadSegment>& segments() const {
+    return m_segments;
+  }
+  // pose of the reference line at s (clamped to the road), moved by t along the road surface to the
+  // left. The segment is found by binary search over the segment starts.
+  Pose evaluate(double s, double t = 0) const;
+  // lateral offset of the center lane from the reference line at s
+  double laneOffset(double s) const {
+    return evaluatePiecewise(m_laneOffsets, s);
+  }
+  // z of the reference line at s
+  double elevation(double s) const {
+    return evaluatePiecewise(m_elevations, s);
+  }
+  // roll angle of the road surface around the reference line at s, positive lifts the left side
+  double superelevation(double s) const {
+    return evaluatePiecewise(m_superelevations, s);
+  }
 
 private:
-  std::shared_ptr<Map> m_map;  // only necessary for map construction.
-
-  std::vector<std::shared_ptr<LaneSection>> m_sections;
-  std::vector<std::shared_ptr<Road>> m_predecessors;
-  std::vector<std::shared_ptr<Road>> m_successors;
-
-  std::vector<glm::vec3> m_roadPoints;
+  const Map* m_map{nullptr};
+  RoadHandle m_handle{0};
+
+  IndexRange m_sections;
+  IndexRange m_predecessors;
+  IndexRange m_successors;
+
+  Polyline m_roadPoints;
+  std::vector<RoadSegment> m_segments;
+  std::vector<CubicPolynomial> m_laneOffsets;
+  std::vector<CubicPolynomial> m_elevations;
+  std::vector<CubicPolynomial> m_superelevations;
   double m_length{0};
-  uint16_t m_id{0};
+  uint32_t m_id{0};
   int m_junction{0};
-  RoadType m_roadType;
+  RoadType m_roadType{RoadType::eROAD};
 
   friend class MapBuilder;
+  friend class MapCache;
+  friend class LaneSection;
 };
 
+// Owns all objects of the map in flat arrays, one per object type. Objects reference each other by
+// handle, the lane sections of a road, the lanes of a section and the connections of a junction are
+// stored consecutively. Links (successors, predecessors) are ranges of one shared link table.
+// Objects are built by the MapBuilder and keep their address until the map is changed.
 class Map {
 public:
-  std::shared_ptr<Road> getRandomRoad();
-  std::vector<std::shared_ptr<Road>> roads() const {
-    return m_roads;
+  Map() = default;
+  Map(const Map& other) = delete;
+  Map& operator=(const Map& other) = delete;
+
+  const Road* getRandomRoad() const;
+  // roads and junctions of the map in file order
+  HandleRange<Road> roads() const {
+    return {m_roads.data(), m_roadOrder};
+  }
+  HandleRange<Junction> junctions() const {
+    return {m_junctions.data(), m_junctionOrder};
+  }
+  // nullptr if the id is unknown, see IdIndex
+  const Road* findRoadById(int rid) const;
+  const Junction* findJunctionById(int jid) const;
+  // objects by handle, the handle has to belong to this map
+  const Road& road(RoadHandle handle) const {
+    return m_roads[handle];
+  }
+  const LaneSection& laneSection(SectionHandle handle) const {
+    return m_sections[handle];
+  }
+  const Lane& lane(LaneHandle handle) const {
+    return m_lanes[handle];
+  }
+  const Junction& junction(JunctionHandle handle) const {
+    return m_junctions[handle];
+  }
+  // materialized lane geometry of lazily loaded maps, nullptr otherwise
+  std::shared_ptr<const GeometryCache> geometryCache() const {
+    return m_geometryCache;
+  }
+  // index for matching positions to lanes, nullptr if the map was loaded without (see
+  // parser::ParserOptions::laneIndex)
+  std::shared_ptr<const LaneIndex> laneIndex() const {
+    return m_laneIndex;
+  }
+  // arc length tables of the lanes, nullptr if the map was loaded without (see
+  // parser::ParserOptions::frenetTable)
+  std::shared_ptr<const FrenetTable> frenetTable() const {
+    return m_frenetTable;
   }
-  std::shared_ptr<Road> findRoadById(int rid);
-  std::shared_ptr<Junction> findJunctionById(int jid);
 
 private:
-  std::vector<std::shared_ptr<Road>> m_roads;
-  // should I use std::vector<Road> here? --> Builder pattern not possible? or
-  // std::vector<std::unique_ptr<Road>> + raw pointers as member map_ for road,
-  // lane?
-  std::vector<std::shared_ptr<Junction>> m_junctions;
+  Span<const uint32_t> links(IndexRange range) const {
+    return {m_links.data() + range.first, range.count};
+  }
+
+  std::vector<Road> m_roads;
+  std::vector<LaneSection> m_sections;
+  std::vector<Lane> m_lanes;
+  std::vector<Junction> m_junctions;
+  std::vector<JunctionConnection> m_connections;
+  // handles of all successors and predecessors, see IndexRange
+  std::vector<uint32_t> m_links;
+  // roads and junctions that are part of the map. A reload leaves replaced objects in the arrays,
+  // handles held by the simulation stay valid.
+  std::vector<RoadHandle> m_roadOrder;
+  std::vector<JunctionHandle> m_junctionOrder;
+  // roads and junctions of the map by id, set by the MapBuilder
+  IdIndex m_roadIndex;
+  IdIndex m_junctionIndex;
+  std::shared_ptr<const MappedFile> m_storage;  // backing memory of borrowed polylines
+  std::shared_ptr<GeometryCache> m_geometryCache;
+  std::shared_ptr<const LaneIndex> m_laneIndex;
+  std::shared_ptr<const FrenetTable> m_frenetTable;
 
   friend class MapBuilder;
+  friend class MapCache;
+  friend class MapStreamer;
+  friend class FrenetTable;
+  friend class Road;
+  friend class LaneSection;
+  friend class Lane;
+  friend class Junction;
 };
 
+inline const LaneSection& Lane::laneSection() const {
+  return m_map->m_sections[m_laneSection];
+}
+// predecessors and successors are swapped on purpose, the simulation drives along successors()
+inline HandleRange<Lane> Lane::predecessors() const {
+  return {m_map->m_lanes.data(), m_map->links(m_successors)};
+}
+inline HandleRange<Lane> Lane::successors() const {
+  return {m_map->m_lanes.data(), m_map->links(m_predecessors)};
+}
+
+inline Span<const Lane> LaneSection::lanes() const {
+  return {m_map->m_lanes.data() + m_lanes.first, m_lanes.count};
+}
+inline const Road& LaneSection::road() const {
+  return m_map->m_roads[m_road];
+}
+inline HandleRange<LaneSection> LaneSection::predecessors() const {
+  return {m_map->m_sections.data(), m_map->links(m_predecessors)};
+}
+inline HandleRange<LaneSection> LaneSection::successors() const {
+  return {m_map->m_sections.data(), m_map->links(m_successors)};
+}
+
+inline Span<const JunctionConnection> Junction::connections() const {
+  return {m_map->m_connections.data() + m_connections.first, m_connections.count};
+}
+
+inline HandleRange<Road> Road::successors() const {
+  return {m_map->m_roads.data(), m_map->links(m_successors)};
+}
+inline HandleRange<Road> Road::predecessors() const {
+  return {m_map->m_roads.data(), m_map->links(m_predecessors)};
+}
+inline Span<const LaneSection> Road::sections() const {
+  return {m_map->m_sections.data() + m_sections.first, m_sections.count};
+}
+
 }  // namespace tsim
 
 #endif  // __TSIM_MAP_HPP__
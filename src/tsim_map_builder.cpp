@@ -1,130 +1,414 @@
 #include "tsim_map_builder.hpp"
 
+#include <algorithm>
 #include <memory>
+#include <stdexcept>
+#include <string>
 
+#include "tsim_geometry_cache.hpp"
 #include "tsim_map.hpp"
 
 namespace tsim {
 
-std::shared_ptr<Road> MapBuilder::addRoad(int id, int junction) {
-  std::shared_ptr<tsim::Road> road = std::make_shared<tsim::Road>(m_map);
-  road->m_id = id;
-  road->m_junction = junction;
+namespace {
+// appends an object to the consecutive objects of its parent in objects
+template <typename T>
+uint32_t addChild(std::vector<T>* objects, IndexRange* children, const char* what,
+                  uint32_t parent) {
+  auto handle = static_cast<uint32_t>(objects->size());
+  if (children->count == 0) {
+    children->first = handle;
+  } else if (children->first + children->count != handle) {
+    throw std::logic_error(std::string(what) + " of " + std::to_string(parent) +
+                           " not added together");
+  }
+  children->count++;
+  objects->emplace_back();
+  return handle;
+}
+}  // namespace
+
+RoadHandle MapBuilder::addRoad(int id, int junction) {
+  auto handle = static_cast<RoadHandle>(m_map->m_roads.size());
+  auto& road = m_map->m_roads.emplace_back();
+  road.m_map = m_map.get();
+  road.m_handle = handle;
+  road.m_id = id;
+  road.m_junction = junction;
   if (junction != -1)
-    road->m_roadType = RoadType::eJUNCTION;
+    road.m_roadType = RoadType::eJUNCTION;
   else
-    road->m_roadType = RoadType::eROAD;
-  m_map->m_roads.push_back(road);
-  return road;
-}
-std::shared_ptr<Road> MapBuilder::getRoad(int id) {
-  auto it =
-    std::find_if(m_map->m_roads.begin(), m_map->m_roads.end(), [id](std::shared_ptr<Road> road) {
-      return road->id() == id;
-    });
-  if (it != m_map->m_roads.end()) return (*it);
-  return nullptr;
-}
-
-std::shared_ptr<Junction> MapBuilder::getJunction(int id) {
-  auto it = std::find_if(m_map->m_junctions.begin(), m_map->m_junctions.end(),
-                         [id](std::shared_ptr<Junction> junction) {
-                           return junction->id() == id;
-                         });
-  if (it != m_map->m_junctions.end()) return (*it);
-  return nullptr;
-}
-
-std::vector<std::shared_ptr<Road>> MapBuilder::junction_findConnectingRoads(Junction* junction,
-                                                                            Road* road) {
-  std::vector<std::shared_ptr<JunctionConnection>> connectingRoads;
-  std::copy_if(junction->m_connections.begin(), junction->m_connections.end(),
-               std::back_inserter(connectingRoads),
-               [road](const std::shared_ptr<JunctionConnection>& connection) {
-                 return connection->m_incomingRoad == road->id();
-               });
-
-  std::vector<std::shared_ptr<Road>> ret;
-  std::transform(connectingRoads.cbegin(), connectingRoads.cend(), std::back_inserter(ret),
-                 [&](const std::shared_ptr<JunctionConnection>& elem) {
-                   return m_map->findRoadById(elem->m_connectingRoad);
-                 });
+    road.m_roadType = RoadType::eROAD;
+  m_roadLinks.add();
+  if (m_editing) {
+    m_stagedRoads.push_back(handle);
+    m_roadIndex.insert(id, handle);
+    m_removedRoads.erase(id);
+    return handle;
+  }
+  m_map->m_roadOrder.push_back(handle);
+  // the first road of an id is found
+  if (m_roadIndex.find(id) == INVALID_HANDLE) m_roadIndex.insert(id, handle);
+  return handle;
+}
+const Road* MapBuilder::getRoad(int id) const {
+  auto handle = m_roadIndex.find(id);
+  return handle != INVALID_HANDLE ? &m_map->m_roads[handle] : nullptr;
+}
+
+const Junction* MapBuilder::getJunction(int id) const {
+  auto handle = m_junctionIndex.find(id);
+  return handle != INVALID_HANDLE ? &m_map->m_junctions[handle] : nullptr;
+}
+
+std::vector<RoadHandle> MapBuilder::junction_findConnectingRoads(const Junction& junction,
+                                                                 const Road& road) const {
+  std::vector<RoadHandle> ret;
+  for (const auto& connection : junction.connections()) {
+    if (connection.m_incomingRoad != road.id()) continue;
+    if (const auto* connecting = getRoad(connection.m_connectingRoad)) {
+      ret.push_back(connecting->m_handle);
+    }
+  }
   return ret;
 }
 
-void MapBuilder::road_addPredecessor(Road* road, std::shared_ptr<Road> predecessor) {
-  road->m_predecessors.push_back(predecessor);
+void MapBuilder::road_addPredecessor(RoadHandle road, RoadHandle predecessor) {
+  m_roadLinks.predecessors[road].push_back(predecessor);
 };
-void MapBuilder::road_addSuccessor(Road* road, std::shared_ptr<Road> successor) {
-  road->m_successors.push_back(successor);
+void MapBuilder::road_addSuccessor(RoadHandle road, RoadHandle successor) {
+  m_roadLinks.successors[road].push_back(successor);
 };
-void MapBuilder::road_addRoadPoints(Road* road, std::vector<Point> points) {
-  road->m_roadPoints.insert(road->m_roadPoints.end(), points.begin(), points.end());
-}
-std::shared_ptr<LaneSection> MapBuilder::road_addLaneSection(std::shared_ptr<Road> road,
-                                                             double s_offset) {
-  std::shared_ptr<LaneSection> lane_section = std::make_shared<LaneSection>(road);
-  lane_section->m_sOffset = s_offset;
-  road->m_sections.push_back(lane_section);
-  return lane_section;
-}
-std::shared_ptr<Lane> MapBuilder::laneSection_addLane(std::shared_ptr<LaneSection> lane_section,
-                                                      uint32_t id, double offset, double width,
-                                                      LaneType type) {
-  std::shared_ptr<Lane> lane = std::make_shared<Lane>(lane_section);
-  lane->m_id = id;
-  lane->m_offset = offset;
-  lane->m_width = width;
-  lane->m_type = type;
-  lane_section->m_lanes.push_back(lane);
-  return lane;
-}
-void MapBuilder::laneSection_addPredecessor(LaneSection* lane_section,
-                                            std::shared_ptr<LaneSection> predecessor) {
-  lane_section->m_predecessors.push_back(predecessor);
-}
-void MapBuilder::laneSection_addSuccessor(LaneSection* lane_section,
-                                          std::shared_ptr<LaneSection> successor) {
-  lane_section->m_successors.push_back(successor);
-}
-void MapBuilder::lane_addLanePoints(Lane* lane, std::vector<Point> points) {
-  lane->m_lanePoints.insert(lane->m_lanePoints.end(), points.begin(), points.end());
-}
-void MapBuilder::lane_addLaneBoundaryPoints(Lane* lane, std::vector<Point> points) {
-  lane->m_laneBoundaryPoints.insert(lane->m_laneBoundaryPoints.end(), points.begin(), points.end());
-}
-void MapBuilder::lane_addPredecessor(Lane* lane, std::shared_ptr<Lane> predecessor) {
-  lane->m_predecessors.push_back(predecessor);
-}
-void MapBuilder::lane_addSuccessor(Lane* lane, std::shared_ptr<Lane> successor) {
-  lane->m_successors.push_back(successor);
-}
-
-std::shared_ptr<Junction> MapBuilder::addJunction(int id) {
-  std::shared_ptr<Junction> junction = std::make_shared<Junction>(m_map);
-  junction->m_id = id;
-  m_map->m_junctions.push_back(junction);
-  return junction;
-}
-std::shared_ptr<JunctionConnection> MapBuilder::junction_addConnection(Junction* junction,
-                                                                       uint32_t incoming_road,
-                                                                       uint32_t connecting_road) {
-  std::shared_ptr<JunctionConnection> connection = std::make_shared<JunctionConnection>();
-  connection->m_incomingRoad = incoming_road;
-  connection->m_connectingRoad = connecting_road;
-  junction->m_connections.push_back(connection);
-  return connection;
-}
-
-void MapBuilder::connection_addLaneLink(JunctionConnection* connection, int from, int to) {
+void MapBuilder::road_addRoadPoints(RoadHandle road, std::vector<Point> points) {
+  auto& owned = m_map->m_roads[road].m_roadPoints.m_owned;
+  if (owned.empty()) {
+    owned = std::move(points);
+    return;
+  }
+  owned.insert(owned.end(), points.begin(), points.end());
+}
+void MapBuilder::road_setRoadPoints(RoadHandle road, Span<const Point> points) {
+  auto& roadPoints = m_map->m_roads[road].m_roadPoints;
+  roadPoints.m_owned.clear();
+  roadPoints.m_borrowed = points;
+}
+void MapBuilder::road_addSegment(RoadHandle handle, const RoadSegment& segment) {
+  auto& road = m_map->m_roads[handle];
+  if (!road.m_segments.empty() && segment.s < road.m_segments.back().s) {
+    throw std::logic_error("segments of road " + std::to_string(road.m_id) + " not ordered by s");
+  }
+  road.m_segments.push_back(segment);
+}
+void MapBuilder::road_setLength(RoadHandle road, double length) {
+  m_map->m_roads[road].m_length = length;
+}
+void MapBuilder::road_addLaneOffset(RoadHandle handle, const CubicPolynomial& lane_offset) {
+  auto& road = m_map->m_roads[handle];
+  if (!road.m_laneOffsets.empty() && lane_offset.sOffset < road.m_laneOffsets.back().sOffset) {
+    throw std::logic_error("lane offsets of road " + std::to_string(road.m_id) +
+                           " not ordered by s");
+  }
+  road.m_laneOffsets.push_back(lane_offset);
+}
+void MapBuilder::road_addElevation(RoadHandle handle, const CubicPolynomial& elevation) {
+  auto& road = m_map->m_roads[handle];
+  if (!road.m_elevations.empty() && elevation.sOffset < road.m_elevations.back().sOffset) {
+    throw std::logic_error("elevations of road " + std::to_string(road.m_id) +
+                           " not ordered by s");
+  }
+  road.m_elevations.push_back(elevation);
+}
+void MapBuilder::road_addSuperelevation(RoadHandle handle, const CubicPolynomial& superelevation) {
+  auto& road = m_map->m_roads[handle];
+  if (!road.m_superelevations.empty() &&
+      superelevation.sOffset < road.m_superelevations.back().sOffset) {
+    throw std::logic_error("superelevations of road " + std::to_string(road.m_id) +
+                           " not ordered by s");
+  }
+  road.m_superelevations.push_back(superelevation);
+}
+SectionHandle MapBuilder::road_addLaneSection(RoadHandle road, double s_offset) {
+  auto handle =
+    addChild(&m_map->m_sections, &m_map->m_roads[road].m_sections, "lane sections of road",
+             m_map->m_roads[road].m_id);
+  auto& lane_section = m_map->m_sections[handle];
+  lane_section.m_map = m_map.get();
+  lane_section.m_handle = handle;
+  lane_section.m_road = road;
+  lane_section.m_sOffset = s_offset;
+  m_sectionLinks.add();
+  return handle;
+}
+LaneHandle MapBuilder::laneSection_addLane(SectionHandle lane_section, int32_t id, double offset,
+                                           LaneType type) {
+  auto& section = m_map->m_sections[lane_section];
+  auto handle = addChild(&m_map->m_lanes, &section.m_lanes, "lanes of lane section of road",
+                         m_map->m_roads[section.m_road].m_id);
+  auto& lane = m_map->m_lanes[handle];
+  lane.m_map = m_map.get();
+  lane.m_handle = handle;
+  lane.m_laneSection = lane_section;
+  lane.m_id = id;
+  lane.m_offset = offset;
+  lane.m_type = type;
+  m_laneLinks.add();
+  return handle;
+}
+void MapBuilder::laneSection_addPredecessor(SectionHandle lane_section, SectionHandle predecessor) {
+  m_sectionLinks.predecessors[lane_section].push_back(predecessor);
+}
+void MapBuilder::laneSection_addSuccessor(SectionHandle lane_section, SectionHandle successor) {
+  m_sectionLinks.successors[lane_section].push_back(successor);
+}
+void MapBuilder::laneSection_setLength(SectionHandle lane_section, double length) {
+  m_map->m_sections[lane_section].m_length = length;
+}
+uint32_t MapBuilder::laneSection_addBoundary(SectionHandle lane_section,
+                                             std::vector<Point> points) {
+  auto& boundaries = m_map->m_sections[lane_section].m_boundaries;
+  Polyline boundary;
+  boundary.m_owned = std::move(points);
+  boundaries.push_back(std::move(boundary));
+  return static_cast<uint32_t>(boundaries.size() - 1);
+}
+uint32_t MapBuilder::laneSection_addBorrowedBoundary(SectionHandle lane_section,
+                                                     Span<const Point> points) {
+  auto& boundaries = m_map->m_sections[lane_section].m_boundaries;
+  Polyline boundary;
+  boundary.m_borrowed = points;
+  boundaries.push_back(std::move(boundary));
+  return static_cast<uint32_t>(boundaries.size() - 1);
+}
+void MapBuilder::laneSection_setBoundaryGenerator(
+  SectionHandle lane_section, std::shared_ptr<const BoundaryGenerator> generator) {
+  if (!m_map->m_geometryCache) {
+    m_map->m_geometryCache = std::make_shared<GeometryCache>();
+  }
+  auto& section = m_map->m_sections[lane_section];
+  section.m_boundaries.clear();
+  section.m_generator = std::move(generator);
+}
+void MapBuilder::lane_setBoundaries(LaneHandle handle, uint32_t inner, uint32_t outer) {
+  auto& lane = m_map->m_lanes[handle];
+  auto boundaries = m_map->m_sections[lane.m_laneSection].boundaryCount();
+  if (inner >= boundaries || outer >= boundaries) {
+    throw std::logic_error("boundary of lane " + std::to_string(lane.m_id) +
+                           " not found in lane section");
+  }
+  lane.m_innerBoundary = inner;
+  lane.m_outerBoundary = outer;
+}
+void MapBuilder::lane_addWidth(LaneHandle handle, const CubicPolynomial& width) {
+  auto& lane = m_map->m_lanes[handle];
+  if (!lane.m_widths.empty() && width.sOffset < lane.m_widths.back().sOffset) {
+    throw std::logic_error("widths of lane " + std::to_string(lane.m_id) + " not ordered by s");
+  }
+  lane.m_widths.push_back(width);
+}
+void MapBuilder::lane_addPredecessor(LaneHandle lane, LaneHandle predecessor) {
+  m_laneLinks.predecessors[lane].push_back(predecessor);
+}
+void MapBuilder::lane_addSuccessor(LaneHandle lane, LaneHandle successor) {
+  m_laneLinks.successors[lane].push_back(successor);
+}
+
+JunctionHandle MapBuilder::addJunction(int id) {
+  auto handle = static_cast<JunctionHandle>(m_map->m_junctions.size());
+  auto& junction = m_map->m_junctions.emplace_back();
+  junction.m_map = m_map.get();
+  junction.m_handle = handle;
+  junction.m_id = id;
+  if (m_editing) {
+    m_stagedJunctions.push_back(handle);
+    m_junctionIndex.insert(id, handle);
+    m_removedJunctions.erase(id);
+    return handle;
+  }
+  m_map->m_junctionOrder.push_back(handle);
+  if (m_junctionIndex.find(id) == INVALID_HANDLE) m_junctionIndex.insert(id, handle);
+  return handle;
+}
+ConnectionHandle MapBuilder::junction_addConnection(JunctionHandle junction,
+                                                    uint32_t incoming_road,
+                                                    uint32_t connecting_road) {
+  auto handle = addChild(&m_map->m_connections, &m_map->m_junctions[junction].m_connections,
+                         "connections of junction", m_map->m_junctions[junction].m_id);
+  auto& connection = m_map->m_connections[handle];
+  connection.m_incomingRoad = incoming_road;
+  connection.m_connectingRoad = connecting_road;
+  return handle;
+}
+
+void MapBuilder::connection_addLaneLink(ConnectionHandle connection, int from, int to) {
   LaneLink lane_link;
   lane_link.from = from;
   lane_link.to = to;
-  connection->m_laneLinks.push_back(lane_link);
+  m_map->m_connections[connection].m_laneLinks.push_back(lane_link);
+}
+
+void MapBuilder::appendLinks(IndexRange* range, std::vector<uint32_t>* pending) {
+  if (pending->empty()) return;
+  auto& links = m_map->m_links;
+  if (range->count == 0) {
+    range->first = static_cast<uint32_t>(links.size());
+  } else if (range->first + range->count != links.size()) {
+    // the links of an object are consecutive, earlier links move behind the end of the table. The
+    // old entries stay, a replaced object may still return them.
+    std::vector<uint32_t> existing(links.begin() + range->first,
+                                   links.begin() + range->first + range->count);
+    range->first = static_cast<uint32_t>(links.size());
+    links.insert(links.end(), existing.begin(), existing.end());
+  }
+  links.insert(links.end(), pending->begin(), pending->end());
+  range->count += static_cast<uint32_t>(pending->size());
+  pending->clear();
+}
+
+void MapBuilder::flushLinks() {
+  auto flush = [this](auto* objects, PendingLinks* pending) {
+    for (std::size_t i = 0; i < pending->predecessors.size(); i++) {
+      appendLinks(&(*objects)[i].m_predecessors, &pending->predecessors[i]);
+      appendLinks(&(*objects)[i].m_successors, &pending->successors[i]);
+    }
+  };
+  flush(&m_map->m_roads, &m_roadLinks);
+  flush(&m_map->m_sections, &m_sectionLinks);
+  flush(&m_map->m_lanes, &m_laneLinks);
+}
+
+void MapBuilder::setStorage(std::shared_ptr<const MappedFile> storage) {
+  m_map->m_storage = std::move(storage);
+}
+
+void MapBuilder::setGeometryCache(std::shared_ptr<GeometryCache> geometry_cache) {
+  m_map->m_geometryCache = std::move(geometry_cache);
+}
+
+void MapBuilder::setLaneIndex(std::shared_ptr<const LaneIndex> lane_index) {
+  m_map->m_laneIndex = std::move(lane_index);
+}
+
+void MapBuilder::setFrenetTable(std::shared_ptr<const FrenetTable> frenet_table) {
+  m_map->m_frenetTable = std::move(frenet_table);
 }
 
 std::shared_ptr<Map> MapBuilder::getMap() {
+  flushLinks();
+  if (!m_editing) {
+    // the arrays grew while the map was built, nothing references the objects yet
+    m_map->m_roads.shrink_to_fit();
+    m_map->m_sections.shrink_to_fit();
+    m_map->m_lanes.shrink_to_fit();
+    m_map->m_junctions.shrink_to_fit();
+    m_map->m_connections.shrink_to_fit();
+    m_map->m_links.shrink_to_fit();
+    // an edited map got its indexes in commit()
+    m_map->m_roadIndex = std::move(m_roadIndex);
+    m_map->m_junctionIndex = std::move(m_junctionIndex);
+  }
+  m_roadIndex.clear();
+  m_junctionIndex.clear();
+  m_roadLinks = {};
+  m_sectionLinks = {};
+  m_laneLinks = {};
+  m_editing = false;
+  m_roadPositions.clear();
+  m_junctionPositions.clear();
   return std::move(m_map);
 }
 
-}  // namespace tsim
\ No newline at end of file
+void MapBuilder::editMap(std::shared_ptr<Map> map) {
+  m_map = std::move(map);
+  m_editing = true;
+  m_stagedRoads.clear();
+  m_stagedJunctions.clear();
+  m_removedRoads.clear();
+  m_removedJunctions.clear();
+  m_roadIndex = m_map->m_roadIndex;
+  m_junctionIndex = m_map->m_junctionIndex;
+  m_roadPositions.clear();
+  m_junctionPositions.clear();
+  m_roadLinks = {};
+  m_sectionLinks = {};
+  m_laneLinks = {};
+  m_roadLinks.resize(m_map->m_roads.size());
+  m_sectionLinks.resize(m_map->m_sections.size());
+  m_laneLinks.resize(m_map->m_lanes.size());
+  for (std::size_t i = 0; i < m_map->m_roadOrder.size(); i++) {
+    m_roadPositions.emplace(m_map->m_roads[m_map->m_roadOrder[i]].m_id, i);
+  }
+  for (std::size_t i = 0; i < m_map->m_junctionOrder.size(); i++) {
+    m_junctionPositions.emplace(m_map->m_junctions[m_map->m_junctionOrder[i]].m_id, i);
+  }
+}
+
+void MapBuilder::removeRoad(int id) {
+  m_roadIndex.erase(id);
+  m_removedRoads.insert(id);
+}
+
+void MapBuilder::removeJunction(int id) {
+  m_junctionIndex.erase(id);
+  m_removedJunctions.insert(id);
+}
+
+void MapBuilder::road_clearLinks(RoadHandle handle) {
+  auto& road = m_map->m_roads[handle];
+  road.m_predecessors = {};
+  road.m_successors = {};
+  m_roadLinks.predecessors[handle].clear();
+  m_roadLinks.successors[handle].clear();
+  for (auto s = road.m_sections.first; s < road.m_sections.first + road.m_sections.count; s++) {
+    auto& section = m_map->m_sections[s];
+    section.m_predecessors = {};
+    section.m_successors = {};
+    m_sectionLinks.predecessors[s].clear();
+    m_sectionLinks.successors[s].clear();
+    for (auto l = section.m_lanes.first; l < section.m_lanes.first + section.m_lanes.count; l++) {
+      m_map->m_lanes[l].m_predecessors = {};
+      m_map->m_lanes[l].m_successors = {};
+      m_laneLinks.predecessors[l].clear();
+      m_laneLinks.successors[l].clear();
+    }
+  }
+}
+
+void MapBuilder::commit() {
+  // staged objects take the place of the ones with the same id, the order of the map is kept.
+  // Positions were taken in editMap, the swap does not walk the map.
+  auto update = [](const auto& objects, std::vector<uint32_t>* order,
+                   std::vector<uint32_t>* staged, std::unordered_map<int, std::size_t>* positions,
+                   const std::unordered_set<int>& removed) {
+    for (auto handle : *staged) {
+      int id = objects[handle].id();
+      auto position = positions->find(id);
+      if (position != positions->end()) {
+        (*order)[position->second] = handle;
+      } else {
+        positions->emplace(id, order->size());
+        order->push_back(handle);
+      }
+    }
+    staged->clear();
+    if (removed.empty()) return;
+    order->erase(std::remove_if(order->begin(), order->end(),
+                                [&objects, &removed](uint32_t handle) {
+                                  return removed.count(objects[handle].id()) > 0;
+                                }),
+                 order->end());
+    positions->clear();
+    for (std::size_t i = 0; i < order->size(); i++) {
+      positions->emplace(objects[(*order)[i]].id(), i);
+    }
+  };
+  update(m_map->m_roads, &m_map->m_roadOrder, &m_stagedRoads, &m_roadPositions, m_removedRoads);
+  update(m_map->m_junctions, &m_map->m_junctionOrder, &m_stagedJunctions, &m_junctionPositions,
+         m_removedJunctions);
+  m_removedRoads.clear();
+  m_removedJunctions.clear();
+  // the builder keeps its indexes for further edits
+  m_map->m_roadIndex = m_roadIndex;
+  m_map->m_junctionIndex = m_junctionIndex;
+}
+
+}  // namespace tsim
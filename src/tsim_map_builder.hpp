@@ -1,7 +1,12 @@
 #ifndef __TSIM_MAP_BUILDER_HPP__
 #define __TSIM_MAP_BUILDER_HPP__
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "tsim_map.hpp"
 
@@ -22,37 +27,127 @@ public:
   MapBuilder& operator=(MapBuilder&& other) = delete;
   ~MapBuilder() = default;
 
-  std::shared_ptr<Road> addRoad(int id, int junction);
-  std::shared_ptr<Road> getRoad(int id);
-  std::shared_ptr<Junction> addJunction(int id);
-  std::shared_ptr<Junction> getJunction(int id);
-
-  void road_addRoadPoints(Road* road, std::vector<Point> points);
-  void road_addPredecessor(Road* road, std::shared_ptr<Road> predecessor);
-  void road_addSuccessor(Road* road, std::shared_ptr<Road> successor);
-
-  std::vector<std::shared_ptr<Road>> junction_findConnectingRoads(Junction* junction, Road* road);
-  std::shared_ptr<JunctionConnection> junction_addConnection(Junction* junction,
-                                                             uint32_t incoming_road,
-                                                             uint32_t connecting_road);
-  void connection_addLaneLink(JunctionConnection* connection, int from, int to);
-
-  std::shared_ptr<LaneSection> road_addLaneSection(std::shared_ptr<Road> road, double s_offset);
-  void laneSection_addPredecessor(LaneSection* lane_section,
-                                  std::shared_ptr<LaneSection> predecessor);
-  void laneSection_addSuccessor(LaneSection* lane_section, std::shared_ptr<LaneSection> successor);
-  std::shared_ptr<Lane> laneSection_addLane(std::shared_ptr<LaneSection> lane_section, uint32_t id,
-                                            double offset, double width, LaneType type);
-
-  void lane_addLanePoints(Lane* lane, std::vector<Point> points);
-  void lane_addLaneBoundaryPoints(Lane* lane, std::vector<Point> points);
-  void lane_addPredecessor(Lane* lane, std::shared_ptr<Lane> predecessor);
-  void lane_addSuccessor(Lane* lane, std::shared_ptr<Lane> successor);
+  // Objects are appended to the arrays of the map and referenced by handle. Pointers returned by
+  // getRoad and getJunction stay valid until the next object of their type is added.
+  RoadHandle addRoad(int id, int junction);
+  const Road* getRoad(int id) const;
+  JunctionHandle addJunction(int id);
+  const Junction* getJunction(int id) const;
+
+  void road_addRoadPoints(RoadHandle road, std::vector<Point> points);
+  void road_setRoadPoints(RoadHandle road, Span<const Point> points);
+  // segments are added in the order of s
+  void road_addSegment(RoadHandle road, const RoadSegment& segment);
+  void road_setLength(RoadHandle road, double length);
+  // lane offset pieces are added in the order of s
+  void road_addLaneOffset(RoadHandle road, const CubicPolynomial& lane_offset);
+  // profile pieces are added in the order of s
+  void road_addElevation(RoadHandle road, const CubicPolynomial& elevation);
+  void road_addSuperelevation(RoadHandle road, const CubicPolynomial& superelevation);
+  void road_addPredecessor(RoadHandle road, RoadHandle predecessor);
+  void road_addSuccessor(RoadHandle road, RoadHandle successor);
+
+  // connecting roads of the junction for road as incoming road, unknown roads are skipped
+  std::vector<RoadHandle> junction_findConnectingRoads(const Junction& junction,
+                                                       const Road& road) const;
+  // connections of a junction are added together, before the next junction
+  ConnectionHandle junction_addConnection(JunctionHandle junction, uint32_t incoming_road,
+                                          uint32_t connecting_road);
+  void connection_addLaneLink(ConnectionHandle connection, int from, int to);
+
+  // lane sections of a road are added together, before the next road, lanes of a lane section
+  // before the next lane section
+  SectionHandle road_addLaneSection(RoadHandle road, double s_offset);
+  void laneSection_addPredecessor(SectionHandle lane_section, SectionHandle predecessor);
+  void laneSection_addSuccessor(SectionHandle lane_section, SectionHandle successor);
+  LaneHandle laneSection_addLane(SectionHandle lane_section, int32_t id, double offset,
+                                 LaneType type);
+
+  void laneSection_setLength(SectionHandle lane_section, double length);
+  // returns the index of the boundary in the lane section
+  uint32_t laneSection_addBoundary(SectionHandle lane_section, std::vector<Point> points);
+  // borrowed points, the memory has to outlive the map (see setStorage)
+  uint32_t laneSection_addBorrowedBoundary(SectionHandle lane_section, Span<const Point> points);
+
+  // boundaries are calculated by generator on first access and kept in the geometry cache of the
+  // map, see setGeometryCache
+  void laneSection_setBoundaryGenerator(SectionHandle lane_section,
+                                        std::shared_ptr<const BoundaryGenerator> generator);
+
+  // inner and outer boundary are indices into the boundaries of the lane's section
+  void lane_setBoundaries(LaneHandle lane, uint32_t inner, uint32_t outer);
+  // width pieces are added in the order of sOffset, relative to the start of the lane section
+  void lane_addWidth(LaneHandle lane, const CubicPolynomial& width);
+  void lane_addPredecessor(LaneHandle lane, LaneHandle predecessor);
+  void lane_addSuccessor(LaneHandle lane, LaneHandle successor);
+
+  // Links are collected per object and moved into the link table of the map here, the objects only
+  // return links flushed before. Adding links to different objects is thread-safe, link passes that
+  // read the links of a previous pass flush in between. getMap() flushes as well.
+  void flushLinks();
+
+  // keeps the memory of borrowed points alive as long as the map
+  void setStorage(std::shared_ptr<const MappedFile> storage);
+  // cache for lazily calculated boundaries, set before adding generators. An unlimited cache is
+  // created if none is set.
+  void setGeometryCache(std::shared_ptr<GeometryCache> geometry_cache);
+  // replaces the lane index of the map, e.g. one built from map() after all roads are added
+  void setLaneIndex(std::shared_ptr<const LaneIndex> lane_index);
+  // replaces the arc length tables of the lanes of the map
+  void setFrenetTable(std::shared_ptr<const FrenetTable> frenet_table);
+  // the map being built or edited, for reading
+  const Map& map() const {
+    return *m_map;
+  }
 
   std::shared_ptr<Map> getMap();
 
+  // Editing a finished map, e.g. to swap in reloaded roads. Roads and junctions of the map are
+  // indexed, added ones are staged: lookups return them, but the map only contains them after
+  // commit(), where they replace the road or junction with the same id. Replaced objects stay in
+  // the arrays of the map, handles that are still held (e.g. by vehicles) stay valid, and so does
+  // their memory until the map is destroyed. Adding objects and links moves the arrays of the map,
+  // the caller synchronizes all changes with readers of the map.
+  void editMap(std::shared_ptr<Map> map);
+  void removeRoad(int id);
+  void removeJunction(int id);
+  // removes all links of the road, its lane sections and lanes
+  void road_clearLinks(RoadHandle road);
+  void commit();
+
 private:
+  // links added since the last flushLinks, by handle
+  struct PendingLinks {
+    std::vector<std::vector<uint32_t>> predecessors;
+    std::vector<std::vector<uint32_t>> successors;
+
+    void add() {
+      predecessors.emplace_back();
+      successors.emplace_back();
+    }
+    void resize(std::size_t size) {
+      predecessors.resize(size);
+      successors.resize(size);
+    }
+  };
+  void appendLinks(IndexRange* range, std::vector<uint32_t>* pending);
+
   std::shared_ptr<Map> m_map;
+  // id indexes used during construction, handed to the map in getMap(). Editing: staged objects
+  // included, the map gets them in commit().
+  IdIndex m_roadIndex;
+  IdIndex m_junctionIndex;
+  PendingLinks m_roadLinks;
+  PendingLinks m_sectionLinks;
+  PendingLinks m_laneLinks;
+  // editing: objects added or removed on commit
+  bool m_editing{false};
+  std::vector<RoadHandle> m_stagedRoads;
+  std::vector<JunctionHandle> m_stagedJunctions;
+  std::unordered_set<int> m_removedRoads;
+  std::unordered_set<int> m_removedJunctions;
+  std::unordered_map<int, std::size_t> m_roadPositions;  // in the roads of the map
+  std::unordered_map<int, std::size_t> m_junctionPositions;
 };
 }  // namespace tsim
 #endif  // __TSIM_MAP_BUILDER_HPP__
\ No newline at end of file
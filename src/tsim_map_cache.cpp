@@ -0,0 +1,486 @@
+#include "tsim_map_cache.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "tsim_map_builder.hpp"
+#include "tsim_mapped_file.hpp"
+
+namespace tsim {
+
+namespace {
+constexpr std::array<char, 8> CACHE_MAGIC{'T', 'S', 'I', 'M', 'M', 'A', 'P', '\0'};
+constexpr uint32_t CACHE_VERSION{7};
+constexpr uint64_t CACHE_ALIGNMENT{8};
+
+// all references between entries are indices into the tables of the file
+struct Range {
+  uint32_t first{0};
+  uint32_t count{0};
+};
+struct Table {
+  uint64_t offset{0};
+  uint64_t count{0};
+};
+struct Header {
+  std::array<char, 8> magic{};
+  uint32_t version{0};
+  uint32_t pointSize{0};
+  uint64_t sourceHash{0};
+  uint64_t fileSize{0};
+  Table roads;
+  Table sections;
+  Table lanes;
+  Table junctions;
+  Table connections;
+  Table laneLinks;
+  Table links;       // road, lane section and lane indices of predecessors/successors
+  Table segments;     // reference line geometry of the roads
+  Table polynomials;  // lane offsets and profiles of the roads, lane widths
+  Table boundaries;   // lane boundaries, point range
+  Table points;
+};
+struct RoadEntry {
+  uint32_t id{0};
+  int32_t junction{0};
+  double length{0};
+  Range segments;
+  Range laneOffsets;
+  Range elevations;
+  Range superelevations;
+  Range sections;
+  Range points;
+  Range predecessors;
+  Range successors;
+};
+struct SegmentEntry {
+  uint32_t type{0};
+  uint32_t reserved{0};
+  double s{0};
+  double x{0};
+  double y{0};
+  double hdg{0};
+  double length{0};
+  double curvature{0};
+  double curvatureEnd{0};
+  double u[4]{};
+  double v[4]{};
+  double pRange{1};
+};
+struct BoundaryEntry {
+  Range points;
+};
+struct SectionEntry {
+  double sOffset{0};
+  double length{0};
+  Range lanes;
+  Range boundaries;
+  Range predecessors;
+  Range successors;
+};
+struct LaneEntry {
+  int32_t id{0};
+  uint32_t type{0};
+  double offset{0};
+  Range widths;
+  uint32_t innerBoundary{0};  // index into the boundaries of the section
+  uint32_t outerBoundary{0};
+  Range predecessors;
+  Range successors;
+};
+struct JunctionEntry {
+  uint32_t id{0};
+  Range connections;
+};
+struct ConnectionEntry {
+  uint32_t incomingRoad{0};
+  uint32_t connectingRoad{0};
+  Range laneLinks;
+};
+struct LaneLinkEntry {
+  int32_t from{0};
+  int32_t to{0};
+};
+
+class CorruptCache : public std::runtime_error {
+public:
+  CorruptCache()
+      : std::runtime_error("corrupt map cache"){};
+};
+
+template <typename T>
+Range appendTable(std::vector<T>* table, Span<const T> elements) {
+  Range range{static_cast<uint32_t>(table->size()), static_cast<uint32_t>(elements.size())};
+  table->insert(table->end(), elements.begin(), elements.end());
+  return range;
+}
+
+// handles of the map to indices of the file, INVALID_HANDLE for objects that are not part of the
+// map (replaced by a reload)
+Range appendLinks(std::vector<uint32_t>* links, Span<const uint32_t> handles,
+                  const std::vector<uint32_t>& index) {
+  Range range{static_cast<uint32_t>(links->size()), 0};
+  for (auto handle : handles) {
+    if (index[handle] == INVALID_HANDLE) continue;
+    links->push_back(index[handle]);
+    range.count++;
+  }
+  return range;
+}
+
+class Writer {
+public:
+  explicit Writer(const std::string& filename)
+      : m_file(filename, std::ios::binary | std::ios::trunc){};
+
+  bool good() const {
+    return m_file.good();
+  }
+  uint64_t size() const {
+    return m_size;
+  }
+
+  template <typename T>
+  Table write(const std::vector<T>& table) {
+    static_assert(std::is_trivially_copyable<T>::value, "cache tables must be trivially copyable");
+    pad();
+    Table result{m_size, table.size()};
+    writeBytes(table.data(), table.size() * sizeof(T));
+    return result;
+  }
+  void writeHeader(const Header& header) {
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  void reserveHeader() {
+    Header header;
+    writeBytes(&header, sizeof(header));
+  }
+
+private:
+  void pad() {
+    static constexpr std::array<char, CACHE_ALIGNMENT> zeros{};
+    writeBytes(zeros.data(), (CACHE_ALIGNMENT - m_size % CACHE_ALIGNMENT) % CACHE_ALIGNMENT);
+  }
+  void writeBytes(const void* data, std::size_t size) {
+    m_file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    m_size += size;
+  }
+
+  std::ofstream m_file;
+  uint64_t m_size{0};
+};
+
+template <typename T>
+Span<const T> tableView(const MappedFile& file, const Table& table) {
+  if (table.offset % CACHE_ALIGNMENT != 0 || table.offset > file.size() ||
+      table.count > (file.size() - table.offset) / sizeof(T)) {
+    throw CorruptCache();
+  }
+  return {reinterpret_cast<const T*>(file.data() + table.offset),
+          static_cast<std::size_t>(table.count)};
+}
+
+template <typename T>
+Span<const T> slice(Span<const T> table, Range range) {
+  if (static_cast<uint64_t>(range.first) + range.count > table.size()) throw CorruptCache();
+  return {table.data() + range.first, range.count};
+}
+
+template <typename T>
+const T& element(const std::vector<T>& objects, uint32_t index) {
+  if (index >= objects.size()) throw CorruptCache();
+  return objects[index];
+}
+}  // namespace
+
+void MapCache::save(const Map& map, const std::string& filename, uint64_t source_hash) {
+  std::vector<uint32_t> roadIndex(map.m_roads.size(), INVALID_HANDLE);
+  std::vector<uint32_t> sectionIndex(map.m_sections.size(), INVALID_HANDLE);
+  std::vector<uint32_t> laneIndex(map.m_lanes.size(), INVALID_HANDLE);
+  uint32_t roadCount{0};
+  uint32_t sectionCount{0};
+  uint32_t laneCount{0};
+  for (const auto& road : map.roads()) {
+    roadIndex[road.m_handle] = roadCount++;
+    for (const auto& section : road.sections()) {
+      sectionIndex[section.m_handle] = sectionCount++;
+      for (const auto& lane : section.lanes()) laneIndex[lane.m_handle] = laneCount++;
+    }
+  }
+
+  std::vector<RoadEntry> roads;
+  std::vector<SectionEntry> sections;
+  std::vector<LaneEntry> lanes;
+  std::vector<JunctionEntry> junctions;
+  std::vector<ConnectionEntry> connections;
+  std::vector<LaneLinkEntry> laneLinks;
+  std::vector<uint32_t> links;
+  std::vector<SegmentEntry> segments;
+  std::vector<CubicPolynomial> polynomials;
+  std::vector<BoundaryEntry> boundaries;
+  std::vector<Point> points;
+
+  for (const auto& road : map.roads()) {
+    RoadEntry roadEntry;
+    roadEntry.id = road.m_id;
+    roadEntry.junction = road.m_junction;
+    roadEntry.length = road.m_length;
+    roadEntry.segments.first = static_cast<uint32_t>(segments.size());
+    for (const auto& segment : road.m_segments) {
+      SegmentEntry segmentEntry;
+      segmentEntry.type = static_cast<uint32_t>(segment.type);
+      segmentEntry.s = segment.s;
+      segmentEntry.x = segment.x;
+      segmentEntry.y = segment.y;
+      segmentEntry.hdg = segment.hdg;
+      segmentEntry.length = segment.length;
+      segmentEntry.curvature = segment.curvature;
+      segmentEntry.curvatureEnd = segment.curvatureEnd;
+      std::copy(segment.u.begin(), segment.u.end(), segmentEntry.u);
+      std::copy(segment.v.begin(), segment.v.end(), segmentEntry.v);
+      segmentEntry.pRange = segment.pRange;
+      segments.push_back(segmentEntry);
+      roadEntry.segments.count++;
+    }
+    roadEntry.laneOffsets =
+      appendTable(&polynomials, Span<const CubicPolynomial>(road.m_laneOffsets));
+    roadEntry.elevations =
+      appendTable(&polynomials, Span<const CubicPolynomial>(road.m_elevations));
+    roadEntry.superelevations =
+      appendTable(&polynomials, Span<const CubicPolynomial>(road.m_superelevations));
+    roadEntry.points = appendTable(&points, road.points());
+    roadEntry.predecessors = appendLinks(&links, map.links(road.m_predecessors), roadIndex);
+    roadEntry.successors = appendLinks(&links, map.links(road.m_successors), roadIndex);
+    roadEntry.sections.first = static_cast<uint32_t>(sections.size());
+    for (const auto& section : road.sections()) {
+      SectionEntry sectionEntry;
+      sectionEntry.sOffset = section.m_sOffset;
+      sectionEntry.length = section.m_length;
+      sectionEntry.predecessors =
+        appendLinks(&links, map.links(section.m_predecessors), sectionIndex);
+      sectionEntry.successors = appendLinks(&links, map.links(section.m_successors), sectionIndex);
+      sectionEntry.boundaries.first = static_cast<uint32_t>(boundaries.size());
+      for (std::size_t i = 0; i < section.boundaryCount(); i++) {
+        boundaries.push_back(BoundaryEntry{appendTable(&points, section.boundary(i))});
+        sectionEntry.boundaries.count++;
+      }
+      sectionEntry.lanes.first = static_cast<uint32_t>(lanes.size());
+      for (const auto& lane : section.lanes()) {
+        LaneEntry laneEntry;
+        laneEntry.id = lane.m_id;
+        laneEntry.type = static_cast<uint32_t>(lane.m_type);
+        laneEntry.offset = lane.m_offset;
+        laneEntry.widths = appendTable(&polynomials, Span<const CubicPolynomial>(lane.m_widths));
+        laneEntry.innerBoundary = lane.m_innerBoundary;
+        laneEntry.outerBoundary = lane.m_outerBoundary;
+        laneEntry.predecessors = appendLinks(&links, map.links(lane.m_predecessors), laneIndex);
+        laneEntry.successors = appendLinks(&links, map.links(lane.m_successors), laneIndex);
+        lanes.push_back(laneEntry);
+        sectionEntry.lanes.count++;
+      }
+      sections.push_back(sectionEntry);
+      roadEntry.sections.count++;
+    }
+    roads.push_back(roadEntry);
+  }
+
+  for (const auto& junction : map.junctions()) {
+    JunctionEntry junctionEntry;
+    junctionEntry.id = junction.m_id;
+    junctionEntry.connections.first = static_cast<uint32_t>(connections.size());
+    for (const auto& connection : junction.connections()) {
+      ConnectionEntry connectionEntry;
+      connectionEntry.incomingRoad = connection.m_incomingRoad;
+      connectionEntry.connectingRoad = connection.m_connectingRoad;
+      connectionEntry.laneLinks.first = static_cast<uint32_t>(laneLinks.size());
+      for (const auto& laneLink : connection.m_laneLinks) {
+        laneLinks.push_back(LaneLinkEntry{laneLink.from, laneLink.to});
+        connectionEntry.laneLinks.count++;
+      }
+      connections.push_back(connectionEntry);
+      junctionEntry.connections.count++;
+    }
+    junctions.push_back(junctionEntry);
+  }
+
+  // write to a temporary file first, rename is atomic for processes loading the cache
+  auto tmpFilename = filename + ".tmp" + std::to_string(::getpid());
+  Header header;
+  {
+    Writer writer(tmpFilename);
+    writer.reserveHeader();
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.pointSize = sizeof(Point);
+    header.sourceHash = source_hash;
+    header.roads = writer.write(roads);
+    header.sections = writer.write(sections);
+    header.lanes = writer.write(lanes);
+    header.junctions = writer.write(junctions);
+    header.connections = writer.write(connections);
+    header.laneLinks = writer.write(laneLinks);
+    header.links = writer.write(links);
+    header.segments = writer.write(segments);
+    header.polynomials = writer.write(polynomials);
+    header.boundaries = writer.write(boundaries);
+    header.points = writer.write(points);
+    header.fileSize = writer.size();
+    writer.writeHeader(header);
+    if (!writer.good()) {
+      std::remove(tmpFilename.c_str());
+      throw std::runtime_error("could not write map cache " + filename);
+    }
+  }
+  if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+    std::remove(tmpFilename.c_str());
+    throw std::runtime_error("could not write map cache " + filename);
+  }
+}
+
+std::shared_ptr<Map> MapCache::load(const std::string& filename, uint64_t source_hash) {
+  std::shared_ptr<const MappedFile> file;
+  try {
+    file = std::make_shared<const MappedFile>(filename);
+  } catch (const std::runtime_error&) {
+    return nullptr;
+  }
+
+  Header header;
+  if (file->size() < sizeof(header)) return nullptr;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION ||
+      header.pointSize != sizeof(Point) || header.sourceHash != source_hash ||
+      header.fileSize != file->size()) {
+    return nullptr;  // stale or foreign cache
+  }
+
+  try {
+    auto roadTable = tableView<RoadEntry>(*file, header.roads);
+    auto sectionTable = tableView<SectionEntry>(*file, header.sections);
+    auto laneTable = tableView<LaneEntry>(*file, header.lanes);
+    auto junctionTable = tableView<JunctionEntry>(*file, header.junctions);
+    auto connectionTable = tableView<ConnectionEntry>(*file, header.connections);
+    auto laneLinkTable = tableView<LaneLinkEntry>(*file, header.laneLinks);
+    auto linkTable = tableView<uint32_t>(*file, header.links);
+    auto segmentTable = tableView<SegmentEntry>(*file, header.segments);
+    auto polynomialTable = tableView<CubicPolynomial>(*file, header.polynomials);
+    auto boundaryTable = tableView<BoundaryEntry>(*file, header.boundaries);
+    auto pointTable = tableView<Point>(*file, header.points);
+
+    MapBuilder builder;
+    std::vector<RoadHandle> roads;
+    std::vector<SectionHandle> sections;
+    std::vector<LaneHandle> lanes;
+    roads.reserve(roadTable.size());
+    sections.reserve(sectionTable.size());
+    lanes.reserve(laneTable.size());
+
+    for (const auto& roadEntry : roadTable) {
+      auto road = builder.addRoad(static_cast<int>(roadEntry.id), roadEntry.junction);
+      builder.road_setRoadPoints(road, slice(pointTable, roadEntry.points));
+      builder.road_setLength(road, roadEntry.length);
+      for (const auto& segmentEntry : slice(segmentTable, roadEntry.segments)) {
+        RoadSegment segment;
+        if (segmentEntry.type > static_cast<uint32_t>(SegmentType::ePARAM_POLY3)) {
+          throw CorruptCache();
+        }
+        segment.type = static_cast<SegmentType>(segmentEntry.type);
+        segment.s = segmentEntry.s;
+        segment.x = segmentEntry.x;
+        segment.y = segmentEntry.y;
+        segment.hdg = segmentEntry.hdg;
+        segment.length = segmentEntry.length;
+        segment.curvature = segmentEntry.curvature;
+        segment.curvatureEnd = segmentEntry.curvatureEnd;
+        std::copy(std::begin(segmentEntry.u), std::end(segmentEntry.u), segment.u.begin());
+        std::copy(std::begin(segmentEntry.v), std::end(segmentEntry.v), segment.v.begin());
+        segment.pRange = segmentEntry.pRange;
+        builder.road_addSegment(road, segment);
+      }
+      for (const auto& laneOffset : slice(polynomialTable, roadEntry.laneOffsets)) {
+        builder.road_addLaneOffset(road, laneOffset);
+      }
+      for (const auto& elevation : slice(polynomialTable, roadEntry.elevations)) {
+        builder.road_addElevation(road, elevation);
+      }
+      for (const auto& superelevation : slice(polynomialTable, roadEntry.superelevations)) {
+        builder.road_addSuperelevation(road, superelevation);
+      }
+      // sections and lanes are stored contiguously in road order
+      if (roadEntry.sections.first != sections.size()) throw CorruptCache();
+      for (const auto& sectionEntry : slice(sectionTable, roadEntry.sections)) {
+        auto section = builder.road_addLaneSection(road, sectionEntry.sOffset);
+        builder.laneSection_setLength(section, sectionEntry.length);
+        for (const auto& boundary : slice(boundaryTable, sectionEntry.boundaries)) {
+          builder.laneSection_addBorrowedBoundary(section, slice(pointTable, boundary.points));
+        }
+        if (sectionEntry.lanes.first != lanes.size()) throw CorruptCache();
+        for (const auto& laneEntry : slice(laneTable, sectionEntry.lanes)) {
+          auto lane = builder.laneSection_addLane(section, laneEntry.id, laneEntry.offset,
+                                                  static_cast<LaneType>(laneEntry.type));
+          for (const auto& width : slice(polynomialTable, laneEntry.widths)) {
+            builder.lane_addWidth(lane, width);
+          }
+          if (laneEntry.innerBoundary >= sectionEntry.boundaries.count ||
+              laneEntry.outerBoundary >= sectionEntry.boundaries.count) {
+            throw CorruptCache();
+          }
+          builder.lane_setBoundaries(lane, laneEntry.innerBoundary, laneEntry.outerBoundary);
+          lanes.push_back(lane);
+        }
+        sections.push_back(section);
+      }
+      roads.push_back(road);
+    }
+
+    // link graph
+    for (std::size_t i = 0; i < roads.size(); i++) {
+      for (auto index : slice(linkTable, roadTable[i].predecessors))
+        builder.road_addPredecessor(roads[i], element(roads, index));
+      for (auto index : slice(linkTable, roadTable[i].successors))
+        builder.road_addSuccessor(roads[i], element(roads, index));
+    }
+    for (std::size_t i = 0; i < sections.size(); i++) {
+      for (auto index : slice(linkTable, sectionTable[i].predecessors))
+        builder.laneSection_addPredecessor(sections[i], element(sections, index));
+      for (auto index : slice(linkTable, sectionTable[i].successors))
+        builder.laneSection_addSuccessor(sections[i], element(sections, index));
+    }
+    for (std::size_t i = 0; i < lanes.size(); i++) {
+      for (auto index : slice(linkTable, laneTable[i].predecessors))
+        builder.lane_addPredecessor(lanes[i], element(lanes, index));
+      for (auto index : slice(linkTable, laneTable[i].successors))
+        builder.lane_addSuccessor(lanes[i], element(lanes, index));
+    }
+
+    for (const auto& junctionEntry : junctionTable) {
+      auto junction = builder.addJunction(static_cast<int>(junctionEntry.id));
+      for (const auto& connectionEntry : slice(connectionTable, junctionEntry.connections)) {
+        auto connection = builder.junction_addConnection(junction, connectionEntry.incomingRoad,
+                                                         connectionEntry.connectingRoad);
+        for (const auto& laneLink : slice(laneLinkTable, connectionEntry.laneLinks)) {
+          builder.connection_addLaneLink(connection, laneLink.from, laneLink.to);
+        }
+      }
+    }
+
+    builder.setStorage(std::move(file));
+    return builder.getMap();
+  } catch (const CorruptCache&) {
+    return nullptr;
+  } catch (const std::logic_error&) {  // rejected by the MapBuilder
+    return nullptr;
+  }
+}
+
+}  // namespace tsim
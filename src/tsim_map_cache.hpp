@@ -0,0 +1,28 @@
+#ifndef __TSIM_MAP_CACHE_HPP__
+#define __TSIM_MAP_CACHE_HPP__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "tsim_map.hpp"
+
+namespace tsim {
+
+// Compiled binary map (.tsimmap). Stores a finished Map as flat tables of fixed size entries that
+// reference each other by index: roads, lane sections, lane boundaries, lanes, junctions,
+// connections, lane links, the link graph and all polyline points. Loading maps the file read-only
+// and lets the polylines of the Map point into the mapping, so processes loading the same cache
+// share its pages.
+class MapCache {
+public:
+  // writes map to filename. source_hash identifies the OpenDRIVE file the map was built from.
+  static void save(const Map& map, const std::string& filename, uint64_t source_hash);
+  // returns nullptr if filename does not exist, is not a valid cache or was built from a different
+  // source
+  static std::shared_ptr<Map> load(const std::string& filename, uint64_t source_hash);
+};
+
+}  // namespace tsim
+
+#endif  // __TSIM_MAP_CACHE_HPP__
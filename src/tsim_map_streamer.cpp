@@ -0,0 +1,193 @@
+#include "tsim_map_streamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include "tsim_geometry_cache.hpp"
+#include "tsim_map.hpp"
+
+namespace tsim {
+
+namespace {
+uint64_t tileKey(int64_t x, int64_t y) {
+  return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y);
+}
+
+int64_t tileCoordinate(double value, double tile_size) {
+  return static_cast<int64_t>(std::floor(value / tile_size));
+}
+
+// distance from p to the square tile (x, y), 0 inside
+double tileDistance(const Point& p, int64_t x, int64_t y, double tile_size) {
+  double dx = std::max({x * tile_size - p.x, 0.0, p.x - (x + 1) * tile_size});
+  double dy = std::max({y * tile_size - p.y, 0.0, p.y - (y + 1) * tile_size});
+  return std::hypot(dx, dy);
+}
+
+// boundaries of the section evaluated from the road geometry every step meters
+GeometryCache::SectionBoundaries coarseBoundaries(const LaneSection& lane_section,
+                                                  std::size_t boundary_count, double step) {
+  const auto& road = lane_section.road();
+  double sStart = lane_section.sOffset();
+  auto steps = static_cast<std::size_t>(std::max(1.0, std::ceil(lane_section.length() / step)));
+  GeometryCache::SectionBoundaries boundaries(boundary_count);
+  for (std::size_t j = 0; j < boundary_count; j++) {
+    boundaries[j].reserve(steps + 1);
+    for (std::size_t i = 0; i <= steps; i++) {
+      double s = sStart + lane_section.length() * i / steps;
+      boundaries[j].push_back(road.evaluate(s, lane_section.boundaryOffset(j, s)).position);
+    }
+  }
+  return boundaries;
+}
+}  // namespace
+
+MapStreamer::MapStreamer(std::shared_ptr<Map> map, StreamingOptions options)
+    : m_map(std::move(map))
+    , m_cache(m_map->m_geometryCache)
+    , m_options(options)
+    , m_pool(std::max<std::size_t>(options.threads, 1) + 1) {  // the pool counts the caller
+  if (m_options.tileSize <= 0 || m_options.coarseStep <= 0) {
+    throw std::invalid_argument("tile size and coarse step must be positive");
+  }
+  for (const auto& road : m_map->roads()) {
+    for (const auto& section : road.sections()) {
+      if (section.m_generator) {
+        m_sections.push_back(SectionState{section.m_handle, section.m_generator});
+      }
+    }
+  }
+  m_statistics.streamedSections = m_sections.size();
+  if (m_sections.empty()) return;
+
+  // coarse boundaries of all sections, calculated in parallel. Their extent assigns the section to
+  // the tiles it overlaps.
+  std::vector<std::pair<Point, Point>> extents(m_sections.size());
+  m_pool.parallelFor(m_sections.size(), [this, &extents](std::size_t i) {
+    const auto& section = m_map->laneSection(m_sections[i].section);
+    auto boundaries =
+      coarseBoundaries(section, section.m_generator->boundaryCount(), m_options.coarseStep);
+    Point low = boundaries.front().front();
+    Point high = low;
+    for (const auto& boundary : boundaries) {
+      for (const auto& point : boundary) {
+        low = {std::min(low.x, point.x), std::min(low.y, point.y), 0};
+        high = {std::max(high.x, point.x), std::max(high.y, point.y), 0};
+      }
+    }
+    extents[i] = {low, high};
+    m_cache->setCoarse(section.m_handle, std::move(boundaries));
+  });
+  for (std::size_t i = 0; i < m_sections.size(); i++) {
+    for (auto x = tileCoordinate(extents[i].first.x, m_options.tileSize);
+         x <= tileCoordinate(extents[i].second.x, m_options.tileSize); x++) {
+      for (auto y = tileCoordinate(extents[i].first.y, m_options.tileSize);
+           y <= tileCoordinate(extents[i].second.y, m_options.tileSize); y++) {
+        m_tiles[tileKey(x, y)].push_back(static_cast<uint32_t>(i));
+      }
+    }
+  }
+  m_statistics.tiles = m_tiles.size();
+  m_cache->setStreamed();
+}
+
+MapStreamer::~MapStreamer() {
+  // queued jobs return without calculating, the pool joins its threads
+  m_stop = true;
+}
+
+void MapStreamer::update(const std::vector<Point>& positions) {
+  std::unordered_set<uint64_t> wanted;
+  auto reach = static_cast<int64_t>(std::ceil(m_options.radius / m_options.tileSize));
+  for (const auto& position : positions) {
+    auto x = tileCoordinate(position.x, m_options.tileSize);
+    auto y = tileCoordinate(position.y, m_options.tileSize);
+    for (auto dx = -reach; dx <= reach; dx++) {
+      for (auto dy = -reach; dy <= reach; dy++) {
+        auto key = tileKey(x + dx, y + dy);
+        if (m_tiles.count(key) &&
+            tileDistance(position, x + dx, y + dy, m_options.tileSize) <= m_options.radius) {
+          wanted.insert(key);
+        }
+      }
+    }
+  }
+
+  std::vector<std::size_t> loads;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto key : wanted) {
+      if (m_activeTiles.count(key)) continue;
+      for (auto index : m_tiles.at(key)) {
+        auto& state = m_sections[index];
+        if (state.activeTiles++ > 0 || state.resident || state.queued) continue;
+        state.queued = true;
+        m_statistics.pendingSections++;
+        loads.push_back(index);
+      }
+    }
+    for (auto key : m_activeTiles) {
+      if (wanted.count(key)) continue;
+      for (auto index : m_tiles.at(key)) {
+        auto& state = m_sections[index];
+        if (--state.activeTiles > 0 || !state.resident) continue;
+        // a section still being calculated is dropped when its job finishes
+        m_cache->erase(state.section);
+        state.resident = false;
+        m_statistics.residentSections--;
+        m_statistics.unloads++;
+      }
+    }
+    m_activeTiles = std::move(wanted);
+    m_statistics.activeTiles = m_activeTiles.size();
+  }
+  for (auto index : loads) {
+    m_pool.submit([this, index]() {
+      load(index);
+    });
+  }
+}
+
+void MapStreamer::load(std::size_t index) {
+  auto section = m_sections[index].section;
+  const auto& generator = *m_sections[index].generator;
+  GeometryCache::SectionBoundaries boundaries;
+  if (!m_stop) {
+    try {
+      boundaries = generator.boundaries();
+    } catch (const std::exception& e) {
+      // the section keeps its coarse boundaries
+      std::cerr << e.what() << std::endl;
+      boundaries.clear();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto& state = m_sections[index];
+  state.queued = false;
+  m_statistics.pendingSections--;
+  if (state.activeTiles > 0 && !boundaries.empty()) {
+    m_cache->insert(section, std::move(boundaries));
+    state.resident = true;
+    m_statistics.residentSections++;
+    m_statistics.loads++;
+  }
+  if (m_statistics.pendingSections == 0) m_idle.notify_all();
+}
+
+void MapStreamer::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this]() {
+    return m_statistics.pendingSections == 0;
+  });
+}
+
+MapStreamer::Statistics MapStreamer::statistics() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_statistics;
+}
+
+}  // namespace tsim
@@ -0,0 +1,93 @@
+#ifndef __TSIM_MAP_STREAMER_HPP__
+#define __TSIM_MAP_STREAMER_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tsim_thread_pool.hpp"
+#include "tsim_util.hpp"
+
+namespace tsim {
+
+class BoundaryGenerator;
+class GeometryCache;
+class Map;
+
+struct StreamingOptions {
+  double tileSize{500};     // edge length of the square tiles [m]
+  double radius{1000};      // lane geometry is resident within this distance of a position [m]
+  double coarseStep{25};    // sample spacing of the coarse boundaries used outside the radius [m]
+  std::size_t threads{1};   // background threads calculating lane geometry
+};
+
+// Region of interest streaming of the lane geometry of a lazily loaded map (see
+// GeometryCache). The map is partitioned into square tiles by the extent of its lane sections.
+// Roads, lanes and their links stay resident, the lane boundaries of every section in a tile near
+// a position are calculated in the background and released once no position is near any more.
+// Lookups never wait for a tile: sections that are not resident return coarse boundaries sampled
+// from the road geometry when the streamer was created. Sections with precalculated boundaries
+// (maps loaded eagerly or from the map cache) are not streamed.
+class MapStreamer {
+public:
+  struct Statistics {
+    std::size_t tiles{0};
+    std::size_t activeTiles{0};       // tiles within the radius of a position
+    std::size_t streamedSections{0};  // lane sections with lazy geometry
+    std::size_t residentSections{0};
+    std::size_t pendingSections{0};   // scheduled, not yet calculated
+    std::size_t loads{0};
+    std::size_t unloads{0};
+  };
+
+  // calculates the coarse boundaries and switches the geometry cache of the map to streaming
+  explicit MapStreamer(std::shared_ptr<Map> map, StreamingOptions options = {});
+  ~MapStreamer();
+  MapStreamer(const MapStreamer& other) = delete;
+  MapStreamer(MapStreamer&& other) = delete;
+  MapStreamer& operator=(const MapStreamer& other) = delete;
+  MapStreamer& operator=(MapStreamer&& other) = delete;
+
+  // positions the geometry is needed around, e.g. all vehicles once per simulation step. Only
+  // schedules loads and releases tiles, does not wait for the background threads.
+  void update(const std::vector<Point>& positions);
+  // blocks until every scheduled section is resident, for tools and tests
+  void wait();
+  Statistics statistics() const;
+
+private:
+  struct SectionState {
+    uint32_t section{0};  // handle in the map
+    // kept alive, a reloaded map may replace the section while it is scheduled
+    std::shared_ptr<const BoundaryGenerator> generator;
+    std::size_t activeTiles{0};  // the section is wanted while this is not 0
+    bool resident{false};
+    bool queued{false};
+  };
+  void load(std::size_t index);
+
+  std::shared_ptr<Map> m_map;
+  std::shared_ptr<GeometryCache> m_cache;
+  StreamingOptions m_options;
+  // tile index (see tileKey) to the lane sections that overlap the tile
+  std::unordered_map<uint64_t, std::vector<uint32_t>> m_tiles;
+  std::unordered_set<uint64_t> m_activeTiles;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_idle;
+  std::vector<SectionState> m_sections;
+  Statistics m_statistics;
+  std::atomic<bool> m_stop{false};
+  // last member: background jobs finish before the state above is destroyed
+  ThreadPool m_pool;
+};
+
+}  // namespace tsim
+
+#endif  // __TSIM_MAP_STREAMER_HPP__
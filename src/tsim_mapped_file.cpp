@@ -0,0 +1,66 @@
+#include "tsim_mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+namespace tsim {
+
+MappedFile::MappedFile(const std::string& filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      throw std::runtime_error("File not found!");
+    }
+    throw std::runtime_error("File could not be loaded!");
+  }
+  struct stat fileStat {};
+  if (::fstat(fd, &fileStat) != 0) {
+    ::close(fd);
+    throw std::runtime_error("File could not be loaded!");
+  }
+  m_size = static_cast<std::size_t>(fileStat.st_size);
+  if (m_size > 0) {
+    void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("File could not be mapped!");
+    }
+    ::madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(data);
+  }
+  ::close(fd);  // the mapping stays valid
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(other.m_data)
+    , m_size(other.m_size)
+    , m_released(other.m_released) {
+  other.m_data = nullptr;
+  other.m_size = 0;
+  other.m_released = 0;
+}
+
+void MappedFile::release(std::size_t end) {
+  if (m_data == nullptr) return;
+  // whole pages only, the mapping starts at a page boundary
+  auto pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  end = std::min(end, m_size) / pageSize * pageSize;
+  if (end > m_released) {
+    ::madvise(const_cast<char*>(m_data) + m_released, end - m_released, MADV_DONTNEED);
+    m_released = end;
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (m_data != nullptr) {
+    ::munmap(const_cast<char*>(m_data), m_size);
+  }
+}
+
+}  // namespace tsim
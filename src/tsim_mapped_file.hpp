@@ -0,0 +1,42 @@
+#ifndef __TSIM_MAPPED_FILE_HPP__
+#define __TSIM_MAPPED_FILE_HPP__
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace tsim {
+
+// Read-only memory mapping of a whole file. Pages are shared with every other process mapping the
+// same file and are only loaded when touched.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& filename);
+  ~MappedFile();
+  MappedFile(const MappedFile& other) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(const MappedFile& other) = delete;
+  MappedFile& operator=(MappedFile&& other) = delete;
+
+  const char* data() const {
+    return m_data;
+  }
+  std::size_t size() const {
+    return m_size;
+  }
+  std::string_view view() const {
+    return {m_data, m_size};
+  }
+  // drops the pages before end from memory, for files that are read once from front to back. The
+  // data stays valid, released pages are read from the file again when touched.
+  void release(std::size_t end);
+
+private:
+  const char* m_data{nullptr};
+  std::size_t m_size{0};
+  std::size_t m_released{0};  // pages before are released
+};
+
+}  // namespace tsim
+
+#endif  // __TSIM_MAPPED_FILE_HPP__
@@ -1,14 +1,22 @@
 #include "tsim_object.hpp"
 
+#include <cmath>
 #include <iostream>
+#include <shared_mutex>
 #include <thread>
 #include <utility>
 
+#include "tsim_frenet.hpp"
 #include "tsim_map.hpp"
 
 namespace tsim {
 using std::shared_ptr;
 
+namespace {
+// distance a vehicle moves along its lane per simulation step [m]
+constexpr double VEHICLE_STEP{1.0};
+}  // namespace
+
 TrafficObject::TrafficObject(shared_ptr<Map> map, Simulator* sim, int id)
     : m_map(std::move(map))
     , m_simulator(sim)
@@ -16,9 +24,10 @@ TrafficObject::TrafficObject(shared_ptr<Map> map, Simulator* sim, int id)
 
 Vehicle::Vehicle(std::shared_ptr<Map> map, Simulator* sim, int id)
     : TrafficObject(std::move(map), sim, id) {
-  m_currentRoad = m_map->getRandomRoad();
-  m_currentLane = m_currentRoad->sections().at(0)->lane(-1);
-  m_position = m_currentLane->startPoint();
+  const auto& lane = m_map->getRandomRoad()->sections().at(0).lane(-1);
+  m_currentLane = lane.handle();
+  m_position = lane.startPoint();
+  m_s = lane.laneSection().sOffset();
 }
 
 void Vehicle::simulate() {
@@ -26,49 +35,58 @@ void Vehicle::simulate() {
 };
 
 void Vehicle::drive() {
-  auto laneSize = m_currentLane->points().size() - 1;
   auto step = std::chrono::milliseconds(20);
-  int laneStep = 0;
-  int stepsTaken{0};
   while (true) {
     auto now = std::chrono::system_clock::now();
     auto target = now + step;
-    m_position = m_currentLane->points().at(laneStep);
+    // the map may only change between steps
+    std::shared_lock<std::shared_mutex> lock(m_simulator->stepMutex());
+    // position is evaluated from the road geometry, the vehicle moves continuously along s.
+    // Right lanes (negative id) are driven in the direction of s, left lanes against it.
+    // objects are resolved from the handle every step, a reload may move them
+    const auto* lane = &m_map->lane(m_currentLane);
+    bool forward = lane->id() < 0;
+    auto pose = lane->evaluate(m_s);
+    m_position = pose.position;
+    // roll, pitch, yaw with x forward and y left, a positive pitch lowers the front. Slope and bank
+    // are along the road and change sign against s.
+    double direction = forward ? 1 : -1;
+    m_orientation.x = static_cast<float>(direction * pose.bank);
+    m_orientation.y = static_cast<float>(-std::atan(direction * pose.slope));
+    m_orientation.z = static_cast<float>(forward ? pose.heading : pose.heading + M_PI);
 
-    if (stepsTaken < laneSize) {
-      if (m_currentLane->id() < 0) {
-        laneStep += 1;
-      } else {
-        laneStep -= 1;
-      }
-      stepsTaken++;
+    // with arc length tables the step is measured along the lane center, vehicles on the outer
+    // lanes of a curve do not speed up. Lanes added by a reload may not have a table yet.
+    const auto& laneSection = lane->laneSection();
+    auto frenet = m_map->frenetTable();
+    bool endReached;
+    if (frenet && frenet->contains(m_currentLane)) {
+      double s = frenet->laneS(m_currentLane, m_s) + (forward ? VEHICLE_STEP : -VEHICLE_STEP);
+      endReached = s > frenet->length(m_currentLane) || s < 0;
+      m_s = frenet->roadS(m_currentLane, s);
+    } else {
+      m_s += forward ? VEHICLE_STEP : -VEHICLE_STEP;
+      endReached =
+        m_s > laneSection.sOffset() + laneSection.length() || m_s < laneSection.sOffset();
     }
-
-    else {
-      // end of road reached
-      std::vector<std::shared_ptr<Lane>> nextLanes;
-      if (m_currentLane->id() < 0) {
-        nextLanes = m_currentLane->successors();
-      } else {
-        nextLanes = m_currentLane->predecessors();
-      }
+    if (endReached) {
+      // end of lane reached
+      auto nextLanes = forward ? lane->successors() : lane->predecessors();
       // pick random road to continue driving
-      auto randIt = nextLanes.begin();
-      std::cout << nextLanes.size() << " currlaneid " << m_currentLane->id() << " currRoadID "
-                << m_currentRoad->id() << std::endl;
-      std::advance(randIt, std::rand() % nextLanes.size());
-      m_currentLane = (*randIt);
-
-      laneSize = m_currentLane->points().size() - 1;
+      std::cout << nextLanes.size() << " currlaneid " << lane->id() << " currRoadID "
+                << laneSection.road().id() << std::endl;
+      lane = &nextLanes[std::rand() % nextLanes.size()];
+      m_currentLane = lane->handle();
 
-      // jump to start/end of new road depending on driving direction
-      if (m_currentLane->id() < 0) {
-        laneStep = 0;
+      // jump to start/end of new lane depending on driving direction
+      const auto& nextSection = lane->laneSection();
+      if (lane->id() < 0) {
+        m_s = nextSection.sOffset();
       } else {
-        laneStep = m_currentLane->points().size() - 1;
+        m_s = nextSection.sOffset() + nextSection.length();
       }
-      stepsTaken = 0;
     }
+    lock.unlock();
     std::this_thread::sleep_until(target);
   }
 }
@@ -28,6 +28,10 @@ public:
   const glm::vec3& getPosition() const {
     return m_position;
   };
+  // roll, pitch and yaw
+  const glm::vec3& getOrientation() const {
+    return m_orientation;
+  };
 
 protected:
   std::shared_ptr<Map> m_map;
@@ -49,8 +53,8 @@ public:
 private:
   void drive();
 
-  std::shared_ptr<Road> m_currentRoad;
-  std::shared_ptr<Lane> m_currentLane;
+  LaneHandle m_currentLane{0};
+  double m_s{0};  // position along the road of the current lane
 };
 
 }  // namespace tsim
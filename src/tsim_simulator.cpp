@@ -1,5 +1,7 @@
 #include "tsim_simulator.hpp"
 //
+#include <chrono>
+
 #include "tsim_object.hpp"
 namespace tsim {
 
@@ -18,6 +20,21 @@ void Simulator::run() {
 void Simulator::addThread(std::thread&& thread) {
   m_threads.emplace_back(std::move(thread));
 }
+void Simulator::streamMap(StreamingOptions options) {
+  m_streamer = std::make_unique<MapStreamer>(m_map, options);
+  addThread(std::thread([this]() {
+    // the streamer only schedules work, the positions are sampled at a fixed rate
+    auto step = std::chrono::milliseconds(100);
+    std::vector<Point> positions;
+    while (true) {
+      auto target = std::chrono::system_clock::now() + step;
+      positions.clear();
+      for (const auto& obj : m_objects) positions.push_back(obj->getPosition());
+      m_streamer->update(positions);
+      std::this_thread::sleep_until(target);
+    }
+  }));
+}
 void Simulator::addVehicle() {
   m_objects.emplace_back(std::make_shared<Vehicle>(m_map, this, m_objects.size()));
 }
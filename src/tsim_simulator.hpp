@@ -1,12 +1,16 @@
 #ifndef __TSIM_SIMULATOR_HPP__
 #define __TSIM_SIMULATOR_HPP__
 
+#include <memory>
+#include <shared_mutex>
 #include <thread>
 #include <utility>
 #include <vector>
 
 #include "osi_publisher.hpp"
 #include "renderer_sfml.hpp"
+#include "tsim_map_streamer.hpp"
+#include "tsim_util.hpp"
 
 namespace tsim {
 class Map;
@@ -24,11 +28,16 @@ public:
   void run();
   void addVehicle();
   void addThread(std::thread &&thread);
+  // lane geometry is kept resident around the objects only, see MapStreamer. Needs a map with lazy
+  // geometry.
+  void streamMap(StreamingOptions options);
 
-  std::vector<std::shared_ptr<TrafficObject>> getObjects() {
-    return m_objects;
-  };
+  // objects are added before run(), the view stays valid while the simulation runs
+  Span<const std::shared_ptr<TrafficObject>> getObjects() const { return m_objects; };
   std::shared_ptr<Map> getMap() { return m_map; };
+  // held shared by every simulation step and while drawing, exclusively while the map is changed
+  // (see parser::OpenDriveParser::reload)
+  std::shared_mutex &stepMutex() { return m_stepMutex; };
 
 private:
   std::shared_ptr<Map> m_map;
@@ -37,6 +46,8 @@ private:
 
   std::vector<std::shared_ptr<TrafficObject>> m_objects;
   std::vector<std::thread> m_threads;
+  std::unique_ptr<MapStreamer> m_streamer;
+  std::shared_mutex m_stepMutex;
 };
 } // namespace tsim
 #endif // __TSIM_SIMULATOR_HPP__
@@ -0,0 +1,91 @@
+#include "tsim_thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+namespace tsim {
+
+ThreadPool::ThreadPool(std::size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  // the thread calling parallelFor works as well, so one worker less is enough
+  for (std::size_t i = 1; i < threads; i++) {
+    m_workers.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+  std::packaged_task<void()> packagedTask(std::move(task));
+  auto future = packagedTask.get_future();
+  if (m_workers.empty()) {
+    packagedTask();
+    return future;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push(std::move(packagedTask));
+  }
+  m_condition.notify_one();
+  return future;
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn) {
+  std::atomic<std::size_t> next{0};
+  auto loop = [&next, &fn, count]() {
+    for (std::size_t i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::future<void>> futures;
+  for (std::size_t i = 0; i < m_workers.size() && i + 1 < count; i++) {
+    futures.push_back(submit(loop));
+  }
+  std::exception_ptr error;
+  try {
+    loop();
+  } catch (...) {
+    error = std::current_exception();
+    next = count;  // stop handing out further indices
+  }
+  for (auto& future : futures) {
+    try {
+      future.get();
+    } catch (...) {
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::work() {
+  while (true) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() {
+        return m_stop || !m_tasks.empty();
+      });
+      if (m_stop && m_tasks.empty()) return;
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+    }
+    task();
+  }
+}
+
+}  // namespace tsim
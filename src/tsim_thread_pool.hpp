@@ -0,0 +1,48 @@
+#ifndef __TSIM_THREAD_POOL_HPP__
+#define __TSIM_THREAD_POOL_HPP__
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace tsim {
+
+// Fixed size pool of worker threads. Used for map construction work that can be split into
+// independent jobs (e.g. tessellation of one road).
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t threads = 0);  // 0: one thread per hardware core
+  ~ThreadPool();
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool(ThreadPool&& other) = delete;
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+  ThreadPool& operator=(ThreadPool&& other) = delete;
+
+  std::size_t size() const {
+    return m_workers.size();
+  }
+
+  std::future<void> submit(std::function<void()> task);
+
+  // calls fn(i) for every i in [0, count). The calling thread takes part in the work, the call
+  // returns once all indices are processed. The first exception thrown by fn is rethrown.
+  void parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn);
+
+private:
+  void work();
+
+  std::vector<std::thread> m_workers;
+  std::queue<std::packaged_task<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop{false};
+};
+
+}  // namespace tsim
+
+#endif  // __TSIM_THREAD_POOL_HPP__
@@ -1,6 +1,9 @@
 
+#include "tsim_util.hpp"
+
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 
 namespace tsim {
@@ -10,6 +13,114 @@ bool almostEqual(double a, double b) {
   return std::abs(a - b) < std::numeric_limits<double>::epsilon();
 }
 
+namespace {
+// splitmix64 finalizer. The shifts carry high bits downwards, every input bit changes about half of
+// the output bits; a multiply alone only carries bits upwards.
+uint64_t mix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// polynomial with coefficients in descending order, Horner scheme
+template <std::size_t N> double polynomial(double x, const double (&coefficients)[N]) {
+  double result = coefficients[0];
+  for (std::size_t i = 1; i < N; i++) result = result * x + coefficients[i];
+  return result;
+}
+// same, with leading coefficient 1 not stored
+template <std::size_t N> double monicPolynomial(double x, const double (&coefficients)[N]) {
+  double result = x + coefficients[0];
+  for (std::size_t i = 1; i < N; i++) result = result * x + coefficients[i];
+  return result;
+}
+
+// C(z) and S(z) for |z| < 1.6
+constexpr double FRESNEL_SN[] = {-2.99181919401019853726E3, 7.08840045257738576863E5,
+                                 -6.29741486205862506537E7, 2.54890880573376359104E9,
+                                 -4.42979518059697779103E10, 3.18016297876567817986E11};
+constexpr double FRESNEL_SD[] = {2.81376268889994315696E2, 4.55847810806532581675E4,
+                                 5.17343888770096400730E6, 4.19320245898111231129E8,
+                                 2.24411795645340920940E10, 6.07366389490084639049E11};
+constexpr double FRESNEL_CN[] = {-4.98843114573573548651E-8, 9.50428062829859605134E-6,
+                                 -6.45191435683965050962E-4, 1.88843319396703850064E-2,
+                                 -2.05525900955013891793E-1, 9.99999999999999998822E-1};
+constexpr double FRESNEL_CD[] = {3.99982968972495980367E-12, 9.15439215774657478799E-10,
+                                 1.25001862479598821474E-7,  1.22262789024179030997E-5,
+                                 8.68029542941784300606E-4,  4.12142090722199792936E-2,
+                                 1.00000000000000000118E0};
+// auxiliary functions f and g for large z
+constexpr double FRESNEL_FN[] = {4.21543555043677546506E-1, 1.43407919780758885261E-1,
+                                 1.15220955073585758835E-2, 3.45017939782574027900E-4,
+                                 4.63613749287867322088E-6, 3.05568983790257605827E-8,
+                                 1.02304514164907233465E-10, 1.72010743268161828879E-13,
+                                 1.34283276233062758925E-16, 3.76329711269987889006E-20};
+constexpr double FRESNEL_FD[] = {7.51586398353378947175E-1, 1.16888925859191382142E-1,
+                                 6.44051526508858611005E-3, 1.55934409164153020873E-4,
+                                 1.84627567348930545870E-6, 1.12699224763999035261E-8,
+                                 3.60140029589371370404E-11, 5.88754533621578410010E-14,
+                                 4.52001434074129701496E-17, 1.25443237090011264384E-20};
+constexpr double FRESNEL_GN[] = {5.04442073643383265887E-1, 1.97102833525523411709E-1,
+                                 1.87648584092575249293E-2, 6.84079380915393090172E-4,
+                                 1.15138826111884280931E-5, 9.82852443688422223854E-8,
+                                 4.45344415861750144738E-10, 1.08268041139020870318E-12,
+                                 1.37555460633261799868E-15, 8.36354435630677421531E-19,
+                                 1.86958710162783235106E-22};
+constexpr double FRESNEL_GD[] = {1.47495759925128324529E0,  3.37748989120019970451E-1,
+                                 2.53603741420338795122E-2, 8.14679107184306179049E-4,
+                                 1.27545075667729118702E-5, 1.04314589657571990585E-7,
+                                 4.60680728146520428211E-10, 1.10273215066240270757E-12,
+                                 1.38796531259578871258E-15, 8.39158816283118707363E-19,
+                                 1.86958710162783236342E-22};
+}  // namespace
+
+void fresnel(const double* z, std::size_t n, double* c, double* s) {
+  for (std::size_t i = 0; i < n; i++) {
+    // z may be the same array as c
+    bool negative = z[i] < 0;
+    double x = std::abs(z[i]);
+    double x2 = x * x;
+    double cc;
+    double ss;
+    if (x2 < 2.5625) {
+      double t = x2 * x2;
+      ss = x * x2 * polynomial(t, FRESNEL_SN) / monicPolynomial(t, FRESNEL_SD);
+      cc = x * polynomial(t, FRESNEL_CN) / polynomial(t, FRESNEL_CD);
+    } else if (x > 36974.0) {
+      cc = 0.5;
+      ss = 0.5;
+    } else {
+      double t = M_PI * x2;
+      double u = 1.0 / (t * t);
+      double f = 1.0 - u * polynomial(u, FRESNEL_FN) / monicPolynomial(u, FRESNEL_FD);
+      double g = polynomial(u, FRESNEL_GN) / monicPolynomial(u, FRESNEL_GD) / t;
+      double cosT = std::cos(M_PI_2 * x2);
+      double sinT = std::sin(M_PI_2 * x2);
+      cc = 0.5 + (f * sinT - g * cosT) / (M_PI * x);
+      ss = 0.5 - (f * cosT + g * sinT) / (M_PI * x);
+    }
+    // odd functions
+    c[i] = negative ? -cc : cc;
+    s[i] = negative ? -ss : ss;
+  }
+}
+
+uint64_t hash64(const void* data, std::size_t size, uint64_t seed) {
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = seed;
+  std::size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    hash = mix64(hash ^ word);
+  }
+  // the last bytes padded with zeros, the size tells them apart from zero bytes
+  uint64_t word{0};
+  if (i < size) std::memcpy(&word, bytes + i, size - i);
+  hash = mix64(hash ^ word);
+  return mix64(hash ^ size);
+}
+
 } // namespace util
 
 } // namespace tsim
@@ -4,19 +4,57 @@
 #include <glm/fwd.hpp>
 
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <stdexcept>
+#include <string>
 
 namespace tsim {
 
 using Point = glm::vec3;
 
+// Non-owning view of contiguous elements, e.g. points owned by a std::vector or stored in a memory
+// mapped file.
+template <typename T> class Span {
+public:
+  Span() = default;
+  Span(T* data, std::size_t size) : m_data(data), m_size(size) {}
+  template <typename Container>
+  Span(Container& container) : m_data(container.data()), m_size(container.size()) {}  // NOLINT
+
+  T* data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  T* begin() const { return m_data; }
+  T* end() const { return m_data + m_size; }
+  T& operator[](std::size_t i) const { return m_data[i]; }
+  T& at(std::size_t i) const {
+    if (i >= m_size) throw std::out_of_range("span index " + std::to_string(i));
+    return m_data[i];
+  }
+  T& front() const { return m_data[0]; }
+  T& back() const { return m_data[m_size - 1]; }
+
+private:
+  T* m_data{nullptr};
+  std::size_t m_size{0};
+};
+
 namespace util {
 
 template <typename T> int sgn(T val) { return (T(0) < val) - (val < T(0)); }
 
 bool almostEqual(double a, double b);
 
+// Fresnel integrals C(z) = int_0^z cos(pi/2 t^2) dt and S(z) = int_0^z sin(pi/2 t^2) dt for n
+// arguments. Rational approximations (Cephes), absolute error below 1e-13.
+void fresnel(const double* z, std::size_t n, double* c, double* s);
+
+// fast non-cryptographic 64 bit hash (8 byte words, each mixed with the splitmix64 finalizer), used
+// to detect changed inputs
+uint64_t hash64(const void* data, std::size_t size, uint64_t seed = 14695981039346656037ULL);
+
 } // namespace util
 
 } // namespace tsim
@@ -0,0 +1,169 @@
+#include "xml_scanner.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace parser {
+
+namespace {
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isNameEnd(char c) {
+  return isSpace(c) || c == '/' || c == '>';
+}
+
+template <typename T>
+T parseNumber(std::string_view text, T default_value) {
+  while (!text.empty() && isSpace(text.front())) text.remove_prefix(1);
+  while (!text.empty() && isSpace(text.back())) text.remove_suffix(1);
+  if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+  T value{};
+  auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (result.ec != std::errc()) return default_value;
+  return value;
+}
+}  // namespace
+
+std::optional<std::string_view> XmlTag::attribute(std::string_view attribute_name) const {
+  std::size_t i = 0;
+  while (i < attributes.size()) {
+    while (i < attributes.size() && isSpace(attributes[i])) i++;
+    if (i >= attributes.size()) break;
+
+    std::size_t nameStart = i;
+    while (i < attributes.size() && attributes[i] != '=' && !isSpace(attributes[i])) i++;
+    auto currentName = attributes.substr(nameStart, i - nameStart);
+    while (i < attributes.size() && isSpace(attributes[i])) i++;
+    if (i >= attributes.size() || attributes[i] != '=') {
+      throw std::runtime_error("malformed attribute in <" + std::string(name) + ">");
+    }
+    i++;
+    while (i < attributes.size() && isSpace(attributes[i])) i++;
+    if (i >= attributes.size() || (attributes[i] != '"' && attributes[i] != '\'')) {
+      throw std::runtime_error("unquoted attribute in <" + std::string(name) + ">");
+    }
+    auto valueEnd = attributes.find(attributes[i], i + 1);
+    if (valueEnd == std::string_view::npos) {
+      throw std::runtime_error("unterminated attribute in <" + std::string(name) + ">");
+    }
+    if (currentName == attribute_name) {
+      return attributes.substr(i + 1, valueEnd - i - 1);
+    }
+    i = valueEnd + 1;
+  }
+  return std::nullopt;
+}
+
+double XmlTag::doubleAttribute(std::string_view attribute_name, double default_value) const {
+  auto value = attribute(attribute_name);
+  return value ? parseNumber(*value, default_value) : default_value;
+}
+
+int XmlTag::intAttribute(std::string_view attribute_name, int default_value) const {
+  auto value = attribute(attribute_name);
+  return value ? parseNumber(*value, default_value) : default_value;
+}
+
+uint32_t XmlTag::unsignedAttribute(std::string_view attribute_name, uint32_t default_value) const {
+  auto value = attribute(attribute_name);
+  return value ? parseNumber(*value, default_value) : default_value;
+}
+
+std::size_t XmlScanner::skipPast(std::string_view terminator, std::size_t from) const {
+  auto end = m_document.find(terminator, from);
+  if (end == std::string_view::npos) {
+    throw std::runtime_error("unterminated markup at offset " + std::to_string(from));
+  }
+  return end + terminator.size();
+}
+
+bool XmlScanner::next(XmlTag* tag) {
+  const char* data = m_document.data();
+  const std::size_t size = m_document.size();
+  while (m_position < size) {
+    const void* open = std::memchr(data + m_position, '<', size - m_position);
+    if (open == nullptr) {
+      m_position = size;
+      return false;
+    }
+    std::size_t start = static_cast<const char*>(open) - data;
+    auto rest = m_document.substr(start);
+
+    if (rest.compare(0, 4, "<!--") == 0) {
+      m_position = skipPast("-->", start + 4);
+      continue;
+    }
+    if (rest.compare(0, 9, "<![CDATA[") == 0) {
+      m_position = skipPast("]]>", start + 9);
+      continue;
+    }
+    if (rest.compare(0, 2, "<?") == 0) {
+      m_position = skipPast("?>", start + 2);
+      continue;
+    }
+    if (rest.compare(0, 2, "<!") == 0) {  // doctype
+      m_position = skipPast(">", start + 2);
+      continue;
+    }
+
+    if (rest.compare(0, 2, "</") == 0) {
+      std::size_t close = skipPast(">", start + 2);
+      auto name = m_document.substr(start + 2, close - 1 - (start + 2));
+      while (!name.empty() && isSpace(name.back())) name.remove_suffix(1);
+      if (m_depth == 0) {
+        throw std::runtime_error("unexpected </" + std::string(name) + ">");
+      }
+      m_depth--;
+      tag->kind = XmlTag::Kind::eEND;
+      tag->name = name;
+      tag->attributes = {};
+      tag->depth = m_depth;
+      m_position = close;
+      return true;
+    }
+
+    // start or empty element tag. '>' may appear inside quoted attribute values.
+    std::size_t nameEnd = start + 1;
+    while (nameEnd < size && !isNameEnd(data[nameEnd])) nameEnd++;
+    std::size_t i = nameEnd;
+    while (i < size && data[i] != '>') {
+      if (data[i] == '"' || data[i] == '\'') {
+        const void* quote = std::memchr(data + i + 1, data[i], size - i - 1);
+        if (quote == nullptr) break;
+        i = static_cast<const char*>(quote) - data;
+      }
+      i++;
+    }
+    if (i >= size) {
+      throw std::runtime_error("unterminated tag at offset " + std::to_string(start));
+    }
+    bool empty = data[i - 1] == '/';
+    tag->kind = empty ? XmlTag::Kind::eEMPTY : XmlTag::Kind::eSTART;
+    tag->name = m_document.substr(start + 1, nameEnd - start - 1);
+    tag->attributes = m_document.substr(nameEnd, (empty ? i - 1 : i) - nameEnd);
+    tag->depth = m_depth;
+    if (!empty) m_depth++;
+    m_position = i + 1;
+    return true;
+  }
+  return false;
+}
+
+bool XmlScanner::nextChild(const XmlTag& parent, XmlTag* child) {
+  if (parent.kind != XmlTag::Kind::eSTART) return false;
+  while (next(child)) {
+    if (child->kind == XmlTag::Kind::eEND) {
+      if (child->depth == parent.depth) return false;  // parent closed
+    } else if (child->depth == parent.depth + 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace parser
@@ -0,0 +1,64 @@
+#ifndef __XML_SCANNER_HPP__
+#define __XML_SCANNER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace parser {
+
+// A tag as found in the document. Name and attributes point into the scanned buffer, nothing is
+// copied.
+struct XmlTag {
+  enum class Kind { eSTART, eEND, eEMPTY };
+
+  Kind kind{Kind::eSTART};
+  std::string_view name;
+  std::string_view attributes;  // raw attribute text of a start or empty element tag
+  std::size_t depth{0};         // number of enclosing elements
+
+  bool is(std::string_view tag_name) const {
+    return name == tag_name;
+  }
+  std::optional<std::string_view> attribute(std::string_view attribute_name) const;
+  double doubleAttribute(std::string_view attribute_name, double default_value = 0) const;
+  int intAttribute(std::string_view attribute_name, int default_value = 0) const;
+  uint32_t unsignedAttribute(std::string_view attribute_name, uint32_t default_value = 0) const;
+};
+
+// Forward-only, zero-copy XML tokenizer. Reports start, end and empty element tags, text,
+// comments, processing instructions, CDATA sections and doctype declarations are skipped. Tag
+// boundaries are found with memchr, which libc implements with vector instructions.
+// Entities in attribute values are not decoded.
+class XmlScanner {
+public:
+  explicit XmlScanner(std::string_view document)
+      : m_document(document){};
+
+  // advances to the next tag, returns false at the end of the document
+  bool next(XmlTag* tag);
+  // advances to the next direct child of parent. Children of previously returned elements that
+  // were not visited are skipped. Returns false once the end tag of parent is reached.
+  bool nextChild(const XmlTag& parent, XmlTag* child);
+
+  std::size_t position() const {
+    return m_position;
+  }
+  // text of an element from its start tag to the current position, e.g. once it has been read
+  std::string_view elementText(const XmlTag& element) const {
+    const char* begin = element.name.data() - 1;  // '<'
+    return {begin, static_cast<std::size_t>(m_document.data() + m_position - begin)};
+  }
+
+private:
+  std::size_t skipPast(std::string_view terminator, std::size_t from) const;
+
+  std::string_view m_document;
+  std::size_t m_position{0};
+  std::size_t m_depth{0};
+};
+
+}  // namespace parser
+
+#endif  // __XML_SCANNER_HPP__
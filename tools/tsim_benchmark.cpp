@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+#include "opendrive_parser.hpp"
+#include "tsim_frenet.hpp"
+#include "tsim_lane_index.hpp"
+#include "tsim_map.hpp"
+#include "tsim_thread_pool.hpp"
+
+// Map loading benchmark. Loads every given OpenDRIVE file several times and reports load time per
+// road, so loading maps of increasing size shows how parse time scales with the road count.
+// "first ms" is the time until the center line of the first lane is available, the time to the
+// first simulation step. Reading, tessellation and merging run as a pipeline: "tess r/s" is the
+// tessellation throughput of one thread, "stall ms" the time reading waited for tessellation and
+// "pipe ms" the wall time of all three stages. With --tiles all files are loaded together as tiles
+// of one map. "map MB" is the heap memory held by the loaded map. With --vehicles N that many
+// vehicles drive VEHICLE_STEPS steps each on the loaded map the way the simulator moves them,
+// "steps/s" is the simulation throughput of one thread. Vehicles start and turn by a fixed
+// sequence, runs on the same file are reproducible (see tsim_map_generator for synthetic maps).
+// With --lookups N "lookup ns" is the time of looking up a road and a junction by id, for N ids in
+// a fixed pseudo random order. The objects are not read, the time should not grow with the map
+// size.
+// --matches N builds the lane index while loading ("index ms", part of the load time) and matches N
+// pseudo random positions within the map extent to their nearest lane in one batch on all threads,
+// "match ns" is the wall time per position. --frenet N builds the arc length tables of the lanes
+// while loading ("frenet ms") and transforms N pseudo random lane positions to world coordinates
+// and back in batches on all threads, "frenet ns" is the wall time per round trip. Vehicles then
+// move along the lane center like in the simulator.
+//
+// usage: tsim_benchmark [--repeat N] [--threads N] [--window N] [--parallel-read] [--tolerance M]
+//                       [--lazy] [--tiles] [--vehicles N] [--lookups N] [--matches N]
+//                       [--frenet N] file.xodr ...
+
+namespace {
+constexpr std::size_t VEHICLE_STEPS{1000};
+// positions farther from every lane [m] are not matched
+constexpr double MATCH_DISTANCE{10};
+
+// keeps the calculation of value from being optimized away
+template <typename T> void keep(const T& value) {
+  asm volatile("" : : "g"(value) : "memory");
+}
+
+// heap memory in use [bytes], freed memory the allocator keeps for reuse is not counted
+std::size_t heapBytes() {
+  auto info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+// lane -1 of the first lane section of the first road from index on that has one, vehicles start
+// on it
+const tsim::Lane* startLane(const tsim::HandleRange<tsim::Road>& roads, std::size_t index) {
+  for (std::size_t i = 0; i < roads.size(); i++) {
+    const auto& road = roads[(index + i) % roads.size()];
+    if (road.sections().empty()) continue;
+    for (const auto& lane : road.sections().front().lanes()) {
+      if (lane.id() == -1) return &lane;
+    }
+  }
+  return nullptr;
+}
+
+// vehicles move 1 m per step along the center of their lane (along the road without arc length
+// tables) and continue on a next lane at its end (tsim::Vehicle::drive), a vehicle without next
+// lane starts again on another road. Returns steps per second.
+double driveVehicles(const tsim::Map& map, std::size_t vehicles) {
+  auto roads = map.roads();
+  const auto* frenet = map.frenetTable().get();
+  if (vehicles == 0 || !startLane(roads, 0)) return 0;
+  auto start = std::chrono::steady_clock::now();
+  double checksum{0};
+  for (std::size_t vehicle = 0; vehicle < vehicles; vehicle++) {
+    std::size_t choice = vehicle * 7919;
+    const auto* lane = startLane(roads, choice);
+    double s = lane->laneSection().sOffset();
+    for (std::size_t step = 0; step < VEHICLE_STEPS; step++) {
+      bool forward = lane->id() < 0;
+      checksum += lane->evaluate(s).position.x;
+      const auto* section = &lane->laneSection();
+      if (frenet) {
+        double laneS = frenet->laneS(lane->handle(), s) + (forward ? 1.0 : -1.0);
+        s = frenet->roadS(lane->handle(), laneS);
+        if (laneS <= frenet->length(lane->handle()) && laneS >= 0) continue;
+      } else {
+        s += forward ? 1.0 : -1.0;
+        if (s <= section->sOffset() + section->length() && s >= section->sOffset()) continue;
+      }
+      auto next = forward ? lane->successors() : lane->predecessors();
+      choice = choice * 6364136223846793005ull + 1442695040888963407ull;
+      if (next.empty()) {
+        lane = startLane(roads, choice >> 33);
+      } else {
+        lane = &next[(choice >> 33) % next.size()];
+      }
+      section = &lane->laneSection();
+      s = lane->id() < 0 ? section->sOffset() : section->sOffset() + section->length();
+    }
+  }
+  double seconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  keep(checksum);
+  return vehicles * VEHICLE_STEPS / seconds;
+}
+
+// ns per road and junction lookup by id
+double lookupIds(const tsim::Map& map, std::size_t lookups) {
+  std::vector<int> roadIds;
+  std::vector<int> junctionIds;
+  for (const auto& road : map.roads()) roadIds.push_back(road.id());
+  for (const auto& junction : map.junctions()) junctionIds.push_back(junction.id());
+  if (lookups == 0 || roadIds.empty()) return 0;
+  auto start = std::chrono::steady_clock::now();
+  std::size_t found{0};
+  uint64_t choice{1};
+  for (std::size_t i = 0; i < lookups; i++) {
+    choice = choice * 6364136223846793005ull + 1442695040888963407ull;
+    if (map.findRoadById(roadIds[(choice >> 33) % roadIds.size()])) found++;
+    if (!junctionIds.empty() &&
+        map.findJunctionById(junctionIds[(choice >> 33) % junctionIds.size()])) {
+      found++;
+    }
+  }
+  double ns =
+    std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  keep(found);
+  return ns / lookups;
+}
+
+// ns per position matched to its nearest lane
+double matchPositions(const tsim::Map& map, std::size_t positions, std::size_t threads) {
+  auto roads = map.roads();
+  if (positions == 0 || !map.laneIndex() || roads.empty()) return 0;
+  tsim::Point low = roads.front().startPoint();
+  tsim::Point high = low;
+  for (const auto& road : roads) {
+    for (const auto& point : road.points()) {
+      low = {std::min(low.x, point.x), std::min(low.y, point.y), 0};
+      high = {std::max(high.x, point.x), std::max(high.y, point.y), 0};
+    }
+  }
+  std::vector<tsim::Point> points(positions);
+  uint64_t choice{1};
+  for (auto& point : points) {
+    choice = choice * 6364136223846793005ull + 1442695040888963407ull;
+    double u = static_cast<double>(choice >> 40) / (1 << 24);
+    choice = choice * 6364136223846793005ull + 1442695040888963407ull;
+    double v = static_cast<double>(choice >> 40) / (1 << 24);
+    point = {low.x + u * (high.x - low.x), low.y + v * (high.y - low.y), 0};
+  }
+  tsim::ThreadPool pool(threads);
+  std::vector<tsim::LaneMatch> matches;
+  auto start = std::chrono::steady_clock::now();
+  map.laneIndex()->nearest(points, MATCH_DISTANCE, &matches, &pool);
+  double ns =
+    std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  return ns / positions;
+}
+
+// ns per lane position transformed to world coordinates and back
+double transformPositions(const tsim::Map& map, std::size_t positions, std::size_t threads) {
+  const auto* frenet = map.frenetTable().get();
+  if (positions == 0 || !frenet || frenet->lanes() == 0) return 0;
+  std::vector<tsim::LaneHandle> lanes(positions);
+  std::vector<double> s(positions);
+  uint64_t choice{1};
+  for (std::size_t i = 0; i < positions; i++) {
+    choice = choice * 6364136223846793005ull + 1442695040888963407ull;
+    lanes[i] = static_cast<tsim::LaneHandle>((choice >> 33) % frenet->lanes());
+    choice = choice * 6364136223846793005ull + 1442695040888963407ull;
+    s[i] = frenet->length(lanes[i]) * static_cast<double>(choice >> 40) / (1 << 24);
+  }
+  tsim::ThreadPool pool(threads);
+  std::vector<tsim::FrenetPose> poses;
+  std::vector<tsim::Point> points(positions);
+  std::vector<tsim::FrenetPosition> results;
+  auto start = std::chrono::steady_clock::now();
+  frenet->poses(lanes, s, &poses, &pool);
+  for (std::size_t i = 0; i < positions; i++) points[i] = tsim::Point(poses[i].x, poses[i].y, 0);
+  frenet->positions(lanes, points, &results, &pool);
+  double ns =
+    std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  return ns / positions;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+  std::size_t repeat{5};
+  parser::ParserOptions options;
+  std::vector<std::string> files;
+  bool tiled{false};
+  std::size_t vehicles{0};
+  std::size_t lookups{0};
+  std::size_t matches{0};
+  std::size_t transforms{0};
+  for (std::size_t i = 0; i < args.size(); i++) {
+    if (args[i] == "--repeat" && i + 1 < args.size()) {
+      repeat = std::max(1, std::atoi(args[++i].c_str()));
+    } else if (args[i] == "--threads" && i + 1 < args.size()) {
+      options.threads = std::max(0, std::atoi(args[++i].c_str()));
+    } else if (args[i] == "--window" && i + 1 < args.size()) {
+      options.inFlightRoads = std::max(0, std::atoi(args[++i].c_str()));
+    } else if (args[i] == "--tolerance" && i + 1 < args.size()) {
+      options.tolerance = std::atof(args[++i].c_str());
+    } else if (args[i] == "--lazy") {
+      options.lazyGeometry = true;
+    } else if (args[i] == "--parallel-read") {
+      options.parallelRead = true;
+    } else if (args[i] == "--tiles") {
+      tiled = true;
+    } else if (args[i] == "--vehicles" && i + 1 < args.size()) {
+      vehicles = std::max(0, std::atoi(args[++i].c_str()));
+    } else if (args[i] == "--lookups" && i + 1 < args.size()) {
+      lookups = std::max(0, std::atoi(args[++i].c_str()));
+    } else if (args[i] == "--matches" && i + 1 < args.size()) {
+      matches = std::max(0, std::atoi(args[++i].c_str()));
+      options.laneIndex = matches > 0;
+    } else if (args[i] == "--frenet" && i + 1 < args.size()) {
+      transforms = std::max(0, std::atoi(args[++i].c_str()));
+      options.frenetTable = transforms > 0;
+    } else {
+      files.push_back(args[i]);
+    }
+  }
+  if (files.empty()) {
+    std::cerr << "usage: tsim_benchmark [--repeat N] [--threads N] [--window N] [--parallel-read] "
+                 "[--tolerance M] [--lazy] [--tiles] [--vehicles N] [--lookups N] [--matches N] "
+                 "[--frenet N] file.xodr ..."
+              << std::endl;
+    return 1;
+  }
+
+  std::printf("%-40s %8s %8s %10s %10s %8s %10s %10s %10s %10s %10s %10s %10s %10s %10s %10s "
+              "%10s %10s %10s %10s %10s %10s %10s %10s\n",
+              "file", "roads", "lanes", "points", "clipped", "threads", "read ms", "read MB/s",
+              "tess ms", "tess r/s", "merge ms", "stall ms", "pipe ms", "link ms", "total ms",
+              "us/road", "first ms", "map MB", "steps/s", "lookup ns", "index ms", "match ns",
+              "frenet ms", "frenet ns");
+  // tiles share the map frame, every tile gets its own id range
+  std::vector<parser::MapTile> tiles;
+  for (std::size_t i = 0; i < files.size(); i++) {
+    parser::MapTile tile;
+    tile.filename = files[i];
+    tile.idOffset = static_cast<uint32_t>(i * 1000000);
+    tiles.push_back(tile);
+  }
+  if (tiled) files = {std::to_string(tiles.size()) + " tiles"};
+
+  for (const auto& file : files) {
+    parser::LoadStatistics best;
+    best.totalMs = -1;
+    double bestFirstMs{-1};
+    double mapMb{0};
+    double stepsPerSecond{0};
+    double lookupNs{0};
+    double matchNs{0};
+    double transformNs{0};
+    for (std::size_t run = 0; run < repeat; run++) {
+      auto heapBefore = heapBytes();
+      auto start = std::chrono::steady_clock::now();
+      parser::OpenDriveParser parser(options);
+      auto map = tiled ? parser.parse(tiles) : parser.parse(file);
+      auto roads = map->roads();
+      if (!roads.empty() && !roads.front().sections().empty() &&
+          !roads.front().sections().front().lanes().empty()) {
+        roads.front().sections().front().lanes().front().startPoint();
+      }
+      double firstMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      const auto& stats = parser.statistics();
+      if (best.totalMs < 0 || stats.totalMs < best.totalMs) best = stats;
+      if (bestFirstMs < 0 || firstMs < bestFirstMs) bestFirstMs = firstMs;
+      // the parser keeps no map data after loading, the difference is the map
+      auto heapAfter = heapBytes();
+      mapMb = heapAfter > heapBefore ? (heapAfter - heapBefore) / 1e6 : 0.0;
+      if (run + 1 == repeat) {
+        stepsPerSecond = driveVehicles(*map, vehicles);
+        lookupNs = lookupIds(*map, lookups);
+        matchNs = matchPositions(*map, matches, options.threads);
+        transformNs = transformPositions(*map, transforms, options.threads);
+      }
+    }
+    std::printf("%-40s %8zu %8zu %10zu %10zu %8zu %10.2f %10.1f %10.2f %10.0f %10.2f %10.2f "
+                "%10.2f %10.2f %10.2f %10.2f %10.2f %10.1f %10.0f %10.1f %10.2f %10.1f %10.2f "
+                "%10.1f\n",
+                file.c_str(), best.roads, best.lanes, best.points, best.clippedPoints, best.threads,
+                best.readMs, best.readMs > 0 ? best.fileBytes / (best.readMs * 1000.0) : 0.0,
+                best.tessellateMs,
+                best.tessellateMs > 0 ? best.roads * 1000.0 / best.tessellateMs : 0.0,
+                best.mergeMs, best.stallMs, best.pipelineMs, best.linkMs, best.totalMs,
+                best.roads > 0 ? best.totalMs * 1000.0 / best.roads : 0.0, bestFirstMs, mapMb,
+                stepsPerSecond, lookupNs, best.laneIndexMs, matchNs, best.frenetMs, transformNs);
+  }
+  return 0;
+}
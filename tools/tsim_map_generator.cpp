@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Synthetic OpenDRIVE networks for scale tests. Writes a grid of junctions connected by two way
+// roads, or a ring of roads linked end to start, with a configurable number of roads, driving lanes
+// per side and lane sections per road. Grid roads are straight or, with --arcs, a fraction of them
+// are S-curves of three arcs; every junction connects each incoming road to every other road (or
+// only straight through with --no-turns) with connecting roads of one line or a quarter circle arc.
+// The output only depends on the options, the same options and --seed always give the same file.
+// Maps range from about 10 roads (--roads 10) to millions, the file is written while the network
+// is generated and never held in memory.
+//
+// usage: tsim_map_generator [--grid | --ring] [--roads N] [--size WxH] [--lanes N] [--sections N]
+//                           [--arcs F] [--no-turns] [--spacing M] [--seed N] out.xodr
+
+namespace {
+enum class Network { eGRID, eRING };
+
+struct GeneratorOptions {
+  Network network{Network::eGRID};
+  std::size_t roads{100};  // approximate number of roads including connecting roads
+  std::size_t width{0};    // grid nodes in x and y, 0: derived from roads
+  std::size_t height{0};
+  int lanes{2};            // driving lanes per side
+  std::size_t sections{1};
+  double arcs{0};          // fraction of curved grid roads
+  bool turns{true};
+  double spacing{200};     // grid: distance between junctions, ring: road length [m]
+  uint64_t seed{1};
+};
+
+constexpr double LANE_WIDTH{3.5};
+constexpr double PI{3.14159265358979323846};
+
+// reproducible uniform value in [0, 1) for element index of the stream seed (splitmix64)
+double uniform(uint64_t seed, uint64_t index) {
+  uint64_t z = seed + (index + 1) * 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  return static_cast<double>(z >> 11) / static_cast<double>(1ull << 53);
+}
+
+struct Pose {
+  double x{0};
+  double y{0};
+  double hdg{0};
+};
+
+// geometries of a reference line, appended at the end pose of the previous one
+class PlanView {
+public:
+  struct Piece {
+    double s{0};
+    Pose start;
+    double length{0};
+    double curvature{0};  // 0: line
+  };
+
+  explicit PlanView(Pose start)
+      : m_end(start) {}
+
+  void line(double length) {
+    m_pieces.push_back({m_length, m_end, length, 0});
+    m_end.x += length * std::cos(m_end.hdg);
+    m_end.y += length * std::sin(m_end.hdg);
+    m_length += length;
+  }
+  void arc(double curvature, double length) {
+    m_pieces.push_back({m_length, m_end, length, curvature});
+    double hdg = m_end.hdg + curvature * length;
+    m_end.x += (std::sin(hdg) - std::sin(m_end.hdg)) / curvature;
+    m_end.y += (std::cos(m_end.hdg) - std::cos(hdg)) / curvature;
+    m_end.hdg = hdg;
+    m_length += length;
+  }
+  // three arcs that leave and rejoin the straight line of the given chord length at the same
+  // heading, the road bulges to the left for a positive angle
+  void sCurve(double chord, double angle) {
+    double curvature = 4 * std::sin(angle) / chord;
+    double length = angle / curvature;
+    arc(curvature, length);
+    arc(-curvature, 2 * length);
+    arc(curvature, length);
+  }
+
+  const std::vector<Piece>& pieces() const {
+    return m_pieces;
+  }
+  double length() const {
+    return m_length;
+  }
+
+private:
+  std::vector<Piece> m_pieces;
+  Pose m_end;
+  double m_length{0};
+};
+
+// lane links of the lanes at a road end: none (end at a junction), to the lane with the same id or
+// to the lane with the opposite id (the neighbouring road runs in the opposite direction)
+enum class LaneLink { eNONE, eSAME, eFLIPPED };
+
+struct RoadLink {
+  const char* elementType{"road"};
+  uint32_t elementId{0};
+  const char* contactPoint{nullptr};
+};
+
+struct RoadSpec {
+  uint32_t id{0};
+  int32_t junction{-1};
+  std::optional<RoadLink> predecessor;
+  std::optional<RoadLink> successor;
+  int leftLanes{0};
+  int rightLanes{0};
+  std::size_t sections{1};
+  LaneLink startLanes{LaneLink::eNONE};
+  LaneLink endLanes{LaneLink::eNONE};
+};
+
+class XodrWriter {
+public:
+  explicit XodrWriter(const std::string& filename)
+      : m_file(std::fopen(filename.c_str(), "w")) {
+    if (!m_file) {
+      std::perror(filename.c_str());
+      std::exit(1);
+    }
+    std::setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+  }
+  ~XodrWriter() {
+    std::fputs("</OpenDRIVE>\n", m_file);
+    std::fclose(m_file);
+  }
+  XodrWriter(const XodrWriter& other) = delete;
+  XodrWriter& operator=(const XodrWriter& other) = delete;
+
+  void header(double north, double south, double east, double west) {
+    std::fprintf(m_file,
+                 "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<OpenDRIVE>\n"
+                 "    <header revMajor=\"1\" revMinor=\"4\" name=\"synthetic\" version=\"1\" "
+                 "north=\"%.12g\" south=\"%.12g\" east=\"%.12g\" west=\"%.12g\" "
+                 "vendor=\"tsim_map_generator\"/>\n",
+                 north, south, east, west);
+  }
+
+  void road(const RoadSpec& spec, const PlanView& plan_view) {
+    std::fprintf(m_file, "    <road name=\"Road %u\" length=\"%.12g\" id=\"%u\" junction=\"%d\">\n",
+                 spec.id, plan_view.length(), spec.id, spec.junction);
+    if (spec.predecessor || spec.successor) {
+      std::fputs("        <link>\n", m_file);
+      if (spec.predecessor) roadLink("predecessor", *spec.predecessor);
+      if (spec.successor) roadLink("successor", *spec.successor);
+      std::fputs("        </link>\n", m_file);
+    }
+    std::fputs("        <planView>\n", m_file);
+    for (const auto& piece : plan_view.pieces()) {
+      std::fprintf(m_file,
+                   "            <geometry s=\"%.12g\" x=\"%.12g\" y=\"%.12g\" hdg=\"%.12g\" "
+                   "length=\"%.12g\">\n",
+                   piece.s, piece.start.x, piece.start.y, piece.start.hdg, piece.length);
+      if (piece.curvature == 0) {
+        std::fputs("                <line/>\n", m_file);
+      } else {
+        std::fprintf(m_file, "                <arc curvature=\"%.12g\"/>\n", piece.curvature);
+      }
+      std::fputs("            </geometry>\n", m_file);
+    }
+    std::fputs("        </planView>\n        <lanes>\n", m_file);
+    for (std::size_t i = 0; i < spec.sections; i++) {
+      std::fprintf(m_file, "            <laneSection s=\"%.12g\">\n",
+                   plan_view.length() * i / spec.sections);
+      bool first = i == 0;
+      bool last = i + 1 == spec.sections;
+      if (spec.leftLanes > 0) {
+        std::fputs("                <left>\n", m_file);
+        for (int id = spec.leftLanes; id > 0; id--) lane(spec, id, first, last);
+        std::fputs("                </left>\n", m_file);
+      }
+      std::fputs("                <center>\n"
+                 "                    <lane id=\"0\" type=\"none\" level=\"false\"/>\n"
+                 "                </center>\n",
+                 m_file);
+      if (spec.rightLanes > 0) {
+        std::fputs("                <right>\n", m_file);
+        for (int id = -1; id >= -spec.rightLanes; id--) lane(spec, id, first, last);
+        std::fputs("                </right>\n", m_file);
+      }
+      std::fputs("            </laneSection>\n", m_file);
+    }
+    std::fputs("        </lanes>\n    </road>\n", m_file);
+    m_roads++;
+    m_lanes += (spec.leftLanes + spec.rightLanes) * spec.sections;
+  }
+
+  void junctionBegin(int32_t id) {
+    std::fprintf(m_file, "    <junction id=\"%d\" name=\"junction%d\">\n", id, id);
+    m_connection = 0;
+  }
+  // connection of a connecting road that starts at the incoming road, lane_links are (from, to)
+  void connection(uint32_t incoming_road, uint32_t connecting_road,
+                  const std::vector<std::pair<int, int>>& lane_links) {
+    std::fprintf(m_file,
+                 "        <connection id=\"%zu\" incomingRoad=\"%u\" connectingRoad=\"%u\" "
+                 "contactPoint=\"start\">\n",
+                 m_connection++, incoming_road, connecting_road);
+    for (const auto& link : lane_links) {
+      std::fprintf(m_file, "            <laneLink from=\"%d\" to=\"%d\"/>\n", link.first,
+                   link.second);
+    }
+    std::fputs("        </connection>\n", m_file);
+  }
+  void junctionEnd() {
+    std::fputs("    </junction>\n", m_file);
+    m_junctions++;
+  }
+
+  std::size_t roads() const {
+    return m_roads;
+  }
+  std::size_t junctions() const {
+    return m_junctions;
+  }
+  std::size_t lanes() const {
+    return m_lanes;
+  }
+
+private:
+  void roadLink(const char* tag, const RoadLink& link) {
+    std::fprintf(m_file, "            <%s elementType=\"%s\" elementId=\"%u\"", tag,
+                 link.elementType, link.elementId);
+    if (link.contactPoint) std::fprintf(m_file, " contactPoint=\"%s\"", link.contactPoint);
+    std::fputs("/>\n", m_file);
+  }
+
+  void lane(const RoadSpec& spec, int id, bool first, bool last) {
+    // lanes keep their id between the sections of a road
+    auto linked = [id](LaneLink link) -> std::optional<int> {
+      if (link == LaneLink::eNONE) return std::nullopt;
+      return link == LaneLink::eSAME ? id : -id;
+    };
+    std::optional<int> predecessor = first ? linked(spec.startLanes) : id;
+    std::optional<int> successor = last ? linked(spec.endLanes) : id;
+    std::fprintf(m_file, "                    <lane id=\"%d\" type=\"driving\" level=\"false\">\n",
+                 id);
+    if (predecessor || successor) {
+      std::fputs("                        <link>\n", m_file);
+      if (predecessor) {
+        std::fprintf(m_file, "                            <predecessor id=\"%d\"/>\n",
+                     *predecessor);
+      }
+      if (successor) {
+        std::fprintf(m_file, "                            <successor id=\"%d\"/>\n", *successor);
+      }
+      std::fputs("                        </link>\n", m_file);
+    }
+    std::fprintf(m_file,
+                 "                        <width sOffset=\"0\" a=\"%.12g\" b=\"0\" c=\"0\" "
+                 "d=\"0\"/>\n"
+                 "                    </lane>\n",
+                 LANE_WIDTH);
+  }
+
+  std::FILE* m_file;
+  std::size_t m_roads{0};
+  std::size_t m_junctions{0};
+  std::size_t m_lanes{0};
+  std::size_t m_connection{0};
+};
+
+// Grid of width x height nodes, node (i, j) at (i, j) * spacing. Nodes are junctions, neighbouring
+// nodes are connected by a road from the lower to the higher node, which starts and ends at the
+// junction radius around the nodes.
+class Grid {
+public:
+  explicit Grid(const GeneratorOptions& options)
+      : m_options(options)
+      , m_width(options.width)
+      , m_height(options.height)
+      , m_radius(2 * options.lanes * LANE_WIDTH + 2) {
+    m_junctionIds.resize(m_width * m_height, -1);
+    uint32_t connectingRoads = 0;
+    for (std::size_t j = 0; j < m_height; j++) {
+      for (std::size_t i = 0; i < m_width; i++) {
+        connectingRoads += static_cast<uint32_t>(connections(i, j).size());
+      }
+    }
+    // junction ids follow the road ids, nodes without connections have no junction
+    m_firstConnectingRoad = roadCount(m_width, m_height);
+    int32_t junctionId = static_cast<int32_t>(m_firstConnectingRoad + connectingRoads);
+    for (std::size_t j = 0; j < m_height; j++) {
+      for (std::size_t i = 0; i < m_width; i++) {
+        if (!connections(i, j).empty()) m_junctionIds[j * m_width + i] = junctionId++;
+      }
+    }
+  }
+
+  // roads between the nodes of a grid
+  static uint32_t roadCount(std::size_t width, std::size_t height) {
+    return static_cast<uint32_t>((width - 1) * height + width * (height - 1));
+  }
+  // smallest square grid with at least roads roads including connecting roads
+  static std::size_t sizeFor(std::size_t roads, bool turns) {
+    for (std::size_t size = 2;; size++) {
+      GeneratorOptions options;
+      options.width = options.height = size;
+      options.turns = turns;
+      Grid grid(options);
+      if (grid.m_firstConnectingRoad + grid.connectingRoadCount() >= roads) return size;
+    }
+  }
+
+  void write(XodrWriter* writer) const {
+    double margin = m_options.spacing / 2;
+    writer->header((m_height - 1) * m_options.spacing + margin, -margin,
+                   (m_width - 1) * m_options.spacing + margin, -margin);
+    double chord = m_options.spacing - 2 * m_radius;
+    for (std::size_t j = 0; j < m_height; j++) {
+      for (std::size_t i = 0; i < m_width; i++) {
+        if (i + 1 < m_width) writeRoad(writer, i, j, 0, chord);
+        if (j + 1 < m_height) writeRoad(writer, i, j, 1, chord);
+      }
+    }
+    uint32_t connectingRoad = m_firstConnectingRoad;
+    for (std::size_t j = 0; j < m_height; j++) {
+      for (std::size_t i = 0; i < m_width; i++) {
+        writeJunction(writer, i, j, &connectingRoad);
+      }
+    }
+  }
+
+private:
+  static constexpr int DX[4]{1, 0, -1, 0};  // legs of a node: east, north, west, south
+  static constexpr int DY[4]{0, 1, 0, -1};
+
+  bool hasLeg(std::size_t i, std::size_t j, int leg) const {
+    return !(leg == 0 && i + 1 == m_width) && !(leg == 1 && j + 1 == m_height) &&
+           !(leg == 2 && i == 0) && !(leg == 3 && j == 0);
+  }
+  // road of a leg, the roads of the east and north legs start at the node
+  uint32_t legRoad(std::size_t i, std::size_t j, int leg) const {
+    if (leg == 2) return legRoad(i - 1, j, 0);
+    if (leg == 3) return legRoad(i, j - 1, 1);
+    if (leg == 0) return static_cast<uint32_t>(j * (m_width - 1) + i);
+    return static_cast<uint32_t>((m_width - 1) * m_height + i * (m_height - 1) + j);
+  }
+  static bool legStarts(int leg) {
+    return leg < 2;
+  }
+  // (from leg, to leg) of the connecting roads of a node
+  std::vector<std::pair<int, int>> connections(std::size_t i, std::size_t j) const {
+    std::vector<std::pair<int, int>> result;
+    for (int from = 0; from < 4; from++) {
+      for (int to = 0; to < 4; to++) {
+        bool straight = (from + 2) % 4 == to;
+        if (from == to || !hasLeg(i, j, from) || !hasLeg(i, j, to)) continue;
+        if (straight || m_options.turns) result.emplace_back(from, to);
+      }
+    }
+    return result;
+  }
+  uint32_t connectingRoadCount() const {
+    uint32_t count = 0;
+    for (std::size_t j = 0; j < m_height; j++) {
+      for (std::size_t i = 0; i < m_width; i++) {
+        count += static_cast<uint32_t>(connections(i, j).size());
+      }
+    }
+    return count;
+  }
+  std::optional<RoadLink> junctionLink(std::size_t i, std::size_t j) const {
+    int32_t id = m_junctionIds[j * m_width + i];
+    if (id < 0) return std::nullopt;
+    return RoadLink{"junction", static_cast<uint32_t>(id), nullptr};
+  }
+
+  // road from node (i, j) along the east (axis 0) or north leg (axis 1)
+  void writeRoad(XodrWriter* writer, std::size_t i, std::size_t j, int axis, double chord) const {
+    RoadSpec spec;
+    spec.id = legRoad(i, j, axis);
+    spec.predecessor = junctionLink(i, j);
+    spec.successor = junctionLink(i + DX[axis], j + DY[axis]);
+    spec.leftLanes = spec.rightLanes = m_options.lanes;
+    spec.sections = m_options.sections;
+    PlanView planView({i * m_options.spacing + DX[axis] * m_radius,
+                       j * m_options.spacing + DY[axis] * m_radius, axis * PI / 2});
+    if (uniform(m_options.seed, spec.id) < m_options.arcs) {
+      double angle = 0.15 + 0.2 * uniform(m_options.seed ^ 1, spec.id);
+      planView.sCurve(chord, uniform(m_options.seed ^ 2, spec.id) < 0.5 ? angle : -angle);
+    } else {
+      planView.line(chord);
+    }
+    writer->road(spec, planView);
+  }
+
+  // connecting roads of a node and their junction. A connecting road starts on the reference line
+  // of the incoming road at the junction radius, its right lanes continue the lanes that drive into
+  // the junction.
+  void writeJunction(XodrWriter* writer, std::size_t i, std::size_t j,
+                     uint32_t* connecting_road) const {
+    auto legs = connections(i, j);
+    if (legs.empty()) return;
+    uint32_t first = *connecting_road;
+    for (const auto& [from, to] : legs) {
+      RoadSpec spec;
+      spec.id = (*connecting_road)++;
+      spec.junction = m_junctionIds[j * m_width + i];
+      spec.predecessor =
+        RoadLink{"road", legRoad(i, j, from), legStarts(from) ? "start" : "end"};
+      spec.successor = RoadLink{"road", legRoad(i, j, to), legStarts(to) ? "start" : "end"};
+      spec.rightLanes = m_options.lanes;
+      spec.startLanes = legStarts(from) ? LaneLink::eFLIPPED : LaneLink::eSAME;
+      spec.endLanes = legStarts(to) ? LaneLink::eSAME : LaneLink::eFLIPPED;
+      // heading into the node, opposite to the leg
+      PlanView planView({i * m_options.spacing + DX[from] * m_radius,
+                         j * m_options.spacing + DY[from] * m_radius, (from + 2) * PI / 2});
+      if ((from + 2) % 4 == to) {
+        planView.line(2 * m_radius);
+      } else {
+        // quarter circle around the corner between both legs, the next leg counterclockwise is a
+        // right turn
+        double curvature = (from + 1) % 4 == to ? -1 / m_radius : 1 / m_radius;
+        planView.arc(curvature, PI / 2 * m_radius);
+      }
+      writer->road(spec, planView);
+    }
+    writer->junctionBegin(m_junctionIds[j * m_width + i]);
+    uint32_t id = first;
+    for (const auto& [from, to] : legs) {
+      std::vector<std::pair<int, int>> laneLinks;
+      for (int lane = 1; lane <= m_options.lanes; lane++) {
+        laneLinks.emplace_back(legStarts(from) ? lane : -lane, -lane);
+      }
+      writer->connection(legRoad(i, j, from), id++, laneLinks);
+    }
+    writer->junctionEnd();
+  }
+
+  GeneratorOptions m_options;
+  std::size_t m_width;
+  std::size_t m_height;
+  double m_radius;  // distance of the road ends from the node
+  uint32_t m_firstConnectingRoad{0};
+  std::vector<int32_t> m_junctionIds;  // by node, -1: no junction
+};
+
+// roads of spacing length on a circle, every road is linked to the next one
+void writeRing(const GeneratorOptions& options, XodrWriter* writer) {
+  double radius = options.roads * options.spacing / (2 * PI);
+  double extent = radius + options.lanes * LANE_WIDTH;
+  if (radius <= options.lanes * LANE_WIDTH) {
+    std::cerr << "ring radius " << radius << " m is smaller than the lanes, increase --spacing"
+              << std::endl;
+    std::exit(1);
+  }
+  writer->header(extent, -extent, extent, -extent);
+  auto count = static_cast<uint32_t>(options.roads);
+  for (uint32_t i = 0; i < count; i++) {
+    RoadSpec spec;
+    spec.id = i;
+    spec.predecessor = RoadLink{"road", (i + count - 1) % count, "end"};
+    spec.successor = RoadLink{"road", (i + 1) % count, "start"};
+    spec.leftLanes = spec.rightLanes = options.lanes;
+    spec.sections = options.sections;
+    spec.startLanes = spec.endLanes = LaneLink::eSAME;
+    double angle = 2 * PI * i / count;
+    PlanView planView({radius * std::cos(angle), radius * std::sin(angle), angle + PI / 2});
+    planView.arc(1 / radius, options.spacing);
+    writer->road(spec, planView);
+  }
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+  GeneratorOptions options;
+  std::string filename;
+  for (std::size_t i = 0; i < args.size(); i++) {
+    if (args[i] == "--grid") {
+      options.network = Network::eGRID;
+    } else if (args[i] == "--ring") {
+      options.network = Network::eRING;
+    } else if (args[i] == "--roads" && i + 1 < args.size()) {
+      options.roads = std::max(1ll, std::atoll(args[++i].c_str()));
+    } else if (args[i] == "--size" && i + 1 < args.size()) {
+      const auto& size = args[++i];
+      options.width = std::max(0, std::atoi(size.c_str()));
+      auto x = size.find('x');
+      options.height = x == std::string::npos ? options.width
+                                              : std::max(0, std::atoi(size.c_str() + x + 1));
+    } else if (args[i] == "--lanes" && i + 1 < args.size()) {
+      options.lanes = std::max(1, std::atoi(args[++i].c_str()));
+    } else if (args[i] == "--sections" && i + 1 < args.size()) {
+      options.sections = std::max(1, std::atoi(args[++i].c_str()));
+    } else if (args[i] == "--arcs" && i + 1 < args.size()) {
+      options.arcs = std::atof(args[++i].c_str());
+    } else if (args[i] == "--no-turns") {
+      options.turns = false;
+    } else if (args[i] == "--spacing" && i + 1 < args.size()) {
+      options.spacing = std::atof(args[++i].c_str());
+    } else if (args[i] == "--seed" && i + 1 < args.size()) {
+      options.seed = std::strtoull(args[++i].c_str(), nullptr, 10);
+    } else {
+      filename = args[i];
+    }
+  }
+  if (filename.empty()) {
+    std::cerr << "usage: tsim_map_generator [--grid | --ring] [--roads N] [--size WxH] [--lanes N] "
+                 "[--sections N] [--arcs F] [--no-turns] [--spacing M] [--seed N] out.xodr"
+              << std::endl;
+    return 1;
+  }
+
+  XodrWriter writer(filename);
+  if (options.network == Network::eRING) {
+    writeRing(options, &writer);
+  } else {
+    if (options.width < 2 || options.height < 2) {
+      options.width = options.height = Grid::sizeFor(options.roads, options.turns);
+    }
+    // the straight part between the junctions has to stay positive
+    if (options.spacing <= 2 * (2 * options.lanes * LANE_WIDTH + 2)) {
+      std::cerr << "--spacing is too small for " << options.lanes << " lanes" << std::endl;
+      return 1;
+    }
+    Grid(options).write(&writer);
+  }
+  std::cout << filename << ": " << writer.roads() << " roads, " << writer.junctions()
+            << " junctions, " << writer.lanes() << " lanes" << std::endl;
+  return 0;
+}